@@ -75,6 +75,8 @@ struct ArenaAllocator
 
 	FreeList* m_freeListHead;
 	GlobalAllocator m_globalAllocator;
+	size_t m_numFallbackAllocations;	//allocations that didn't fit in the pool and went to m_globalAllocator
+	size_t m_numBytesInUse;				//requested bytes currently allocated, from the pool or the fallback
 
 	ArenaAllocator(void* begin, void* end) :
 		m_begin(begin),
@@ -87,6 +89,13 @@ struct ArenaAllocator
 	{
 		m_freeListHead = nullptr;
 		m_curr = static_cast<char*>(m_begin);
+		m_numFallbackAllocations = 0;
+		m_numBytesInUse = 0;
+	}
+
+	size_t Capacity() const
+	{
+		return static_cast<char*>(m_end) - static_cast<char*>(m_begin);
 	}
 
 	size_t SizeToAllocate(size_t size)
@@ -101,6 +110,7 @@ struct ArenaAllocator
 
 	void* Allocate(size_t sizeBytes)
 	{		
+		m_numBytesInUse += sizeBytes;
 		if ( sizeBytes <= MIN_BLOCK_SIZE && m_freeListHead)
 		{
 			//printf("-- allocated from the freelist --\n");
@@ -121,6 +131,7 @@ struct ArenaAllocator
 			}
 			else
 			{
+				m_numFallbackAllocations++;
 				return m_globalAllocator.Allocate(sizeBytes);
 			}
 		}
@@ -129,6 +140,7 @@ struct ArenaAllocator
 	void DeAllocate(void* ptr, size_t osize)
 	{
 		assert(ptr != nullptr);		//can't decallocate null!!!
+		m_numBytesInUse -= osize;
 		if (ptr >= m_begin && ptr <= m_end)
 		{
 			size_t allocatedBytes = SizeToAllocate(osize);
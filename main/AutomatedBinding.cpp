@@ -1,9 +1,30 @@
 #include "AutomatedBinding.h"
 #include "ArenaAllocator.h"
+#include "BindingManifest.h"
+#include "BindingStats.h"
+#include "ContainerView.h"
+#include "DeferredDestruction.h"
+#include "DirtyTracking.h"
+#include "ScriptProfiler.h"
+#include "ScriptScheduler.h"
+#include "ScriptTrace.h"
 #include <cstdio>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <assert.h>
 
+#if defined(__cpp_lib_string_view) || ( defined(_MSVC_LANG) && _MSVC_LANG >= 201703L )
+#include <string_view>
+#define BINDING_STD_STRING_VIEW 1
+#endif
+
 int CreateUserDatumFromVariant( lua_State* L, const rttr::variant& v );
+int InvokeFuncOnUserDatum( lua_State* L );
+void PushMetaTable( lua_State* L, const rttr::type& t );
 
 int ToLua( lua_State* L, rttr::variant& result )
 {
@@ -24,6 +45,44 @@ int ToLua( lua_State* L, rttr::variant& result )
 			lua_pushnumber(L, result.get_value<short>());
 			numberOfReturnValues++;
 		}
+		//strings are copied straight from the native memory in to Lua
+		else if (result.is_type<std::string>())
+		{
+			const std::string& str = result.get_value<std::string>();
+			lua_pushlstring(L, str.data(), str.size());
+			numberOfReturnValues++;
+		}
+		else if (result.is_type<std::string*>())
+		{
+			const std::string* str = result.get_value<std::string*>();
+			lua_pushlstring(L, str->data(), str->size());
+			numberOfReturnValues++;
+		}
+		else if (result.is_type<const char*>())
+		{
+			lua_pushstring(L, result.get_value<const char*>());
+			numberOfReturnValues++;
+		}
+		else if (result.is_type<rttr::string_view>())
+		{
+			const rttr::string_view& str = result.get_value<rttr::string_view>();
+			lua_pushlstring(L, str.data(), str.size());
+			numberOfReturnValues++;
+		}
+#if BINDING_STD_STRING_VIEW
+		else if (result.is_type<std::string_view>())
+		{
+			const std::string_view& str = result.get_value<std::string_view>();
+			lua_pushlstring(L, str.data(), str.size());
+			numberOfReturnValues++;
+		}
+#endif
+		else if ( IsViewableContainer( result ) )
+		{
+			//a container returned by value is owned by the view, one returned by pointer has no owner to keep it
+			//alive, so it's read only as on the property path
+			numberOfReturnValues += PushContainerView( L, result, 0, result.get_type().is_pointer() );
+		}
 		else if ( result.get_type().is_class() || result.get_type().is_pointer() )
 		{
 			numberOfReturnValues += CreateUserDatumFromVariant( L, result );
@@ -41,9 +100,13 @@ int ToLua( lua_State* L, rttr::variant& result )
 /*! \brief Invoke #methodToInvoke on #object, passing the arguments to the method from Lua and leave the result on the Lua stack.
 *	- Assumes that the top of the stack downwards is filled with the parameters to the method we are invoking.
 *	- To call a free function pass rttr::instance = {} as #object
-* \return the number of values left on the Lua stack */
+* \return the number of values left on the Lua stack, or PENDING_RESULT if the caller has to YieldForPendingResult() */
 int InvokeMethod( lua_State* L, rttr::method& methodToInvoke, rttr::instance& object )
 {
+	const bool recordStats = BindingStatsEnabled();
+	const bool recordTrace = TracingEnabled();
+	const uint64_t marshalStart = recordStats || recordTrace ? BindingStatsNow() : 0;	//the same clock as TraceNow
+
 	rttr::array_range<rttr::parameter_info> nativeParams = methodToInvoke.get_parameter_infos();
 	int luaParamsStackOffset = 0;
 	int numNativeArgs = (int)nativeParams.size();
@@ -61,47 +124,161 @@ int InvokeMethod( lua_State* L, rttr::method& methodToInvoke, rttr::instance& ob
 	}
 	union PassByValue
 	{
+		PassByValue() : intVal(0) {}		//the string views have constructors, the union needs one of its own
 		int intVal;
 		short shortVal;
+		const char* cStringVal;				//borrowed from Lua, the strings stay on the stack until the call returns
+		rttr::string_view stringViewVal;
+#if BINDING_STD_STRING_VIEW
+		std::string_view stdStringViewVal;
+#endif
 	};
 
-	std::vector<PassByValue> pbv(numNativeArgs);
-	std::vector<rttr::argument> nativeArgs(numNativeArgs);
-	auto nativeParamsIt = nativeParams.begin();
-	for (int i = 0; i < numLuaArgs; i++, nativeParamsIt++)
+	//errors are only raised once the vectors below are destroyed, luaL_error longjmps past destructors & they can
+	//hold a std::string or a reference to a bound object
+	char errorMessage[256] = "";
+	uint64_t executeStart = 0;
+	rttr::variant result;
 	{
-		const rttr::type nativeParamType = nativeParamsIt->get_type();
-		int luaArgIdx = i + 1 + luaParamsStackOffset;
-		int luaType = lua_type(L, luaArgIdx);
-		switch (luaType)
+		std::vector<PassByValue> pbv(numNativeArgs);
+		std::vector<rttr::argument> nativeArgs(numNativeArgs);
+		//only made for the args that need them, nativeArgs points into these so they're reserved up front & never grow
+		std::vector<std::string> stringVals;			//a copy, the only way to make a std::string
+		std::vector<rttr::variant> objectVals;			//a bound object, as the parameter's pointer type
+		auto nativeParamsIt = nativeParams.begin();
+		for (int i = 0; i < numLuaArgs; i++, nativeParamsIt++)
 		{
-		case LUA_TNUMBER:
-			if (nativeParamType == rttr::type::get<int>())
+			const rttr::type nativeParamType = nativeParamsIt->get_type();
+			int luaArgIdx = i + 1 + luaParamsStackOffset;
+			int luaType = lua_type(L, luaArgIdx);
+			switch (luaType)
+			{
+			case LUA_TNUMBER:
+				if (nativeParamType == rttr::type::get<int>())
+				{
+					pbv[i].intVal = (int)lua_tonumber(L, luaArgIdx);
+					nativeArgs[i] = pbv[i].intVal;
+				}
+				else if (nativeParamType == rttr::type::get<short>())
+				{
+					pbv[i].shortVal = (short)lua_tonumber(L, luaArgIdx);
+					nativeArgs[i] = pbv[i].shortVal;
+				}
+				else
+				{
+					printf("unrecognised parameter type '%s'\n", nativeParamType.get_name().to_string().c_str());
+					assert(false);
+				}
+				break;
+			case LUA_TSTRING:
 			{
-				pbv[i].intVal = (int)lua_tonumber(L, luaArgIdx);
-				nativeArgs[i] = pbv[i].intVal;
+				size_t length = 0;
+				const char* str = lua_tolstring(L, luaArgIdx, &length);
+				if (nativeParamType == rttr::type::get<const char*>())
+				{
+					pbv[i].cStringVal = str;
+					nativeArgs[i] = pbv[i].cStringVal;
+				}
+				else if (nativeParamType == rttr::type::get<rttr::string_view>())
+				{
+					pbv[i].stringViewVal = rttr::string_view(str, length);
+					nativeArgs[i] = pbv[i].stringViewVal;
+				}
+#if BINDING_STD_STRING_VIEW
+				else if (nativeParamType == rttr::type::get<std::string_view>())
+				{
+					pbv[i].stdStringViewVal = std::string_view(str, length);
+					nativeArgs[i] = pbv[i].stdStringViewVal;
+				}
+#endif
+				else if (nativeParamType == rttr::type::get<std::string>())
+				{
+					stringVals.reserve(numNativeArgs);
+					stringVals.emplace_back(str, length);
+					nativeArgs[i] = stringVals.back();
+				}
+				else
+				{
+					snprintf(errorMessage, sizeof(errorMessage), "Can't pass a string as parameter %d of '%s', it takes a '%s'",
+						i, methodToInvoke.get_name().to_string().c_str(), nativeParamType.get_name().to_string().c_str());
+				}
+				break;
 			}
-			else if (nativeParamType == rttr::type::get<short>())
+			case LUA_TUSERDATA:
 			{
-				pbv[i].shortVal = (short)lua_tonumber(L, luaArgIdx);
-				nativeArgs[i] = pbv[i].shortVal;
+				//a bound object of the parameter's class or one derived from it, checked by type id rather than metatable name
+				UserDatum* ud = ToUserDatum(L, luaArgIdx, nativeParamType);
+				if (ud)
+				{
+					objectVals.reserve(numNativeArgs);
+					objectVals.push_back(ud->m_object);
+					if (objectVals.back().get_type().is_wrapper())
+					{
+						objectVals.back() = objectVals.back().extract_wrapped_value();	//e.g. a std::shared_ptr<T> to its T*
+					}
+					if (objectVals.back().get_type() != nativeParamType)
+					{
+						objectVals.back().convert(nativeParamType);		//a derived class pointer to the base class pointer
+					}
+				}
+				if (ud == nullptr || objectVals.back().get_type() != nativeParamType)
+				{
+					snprintf(errorMessage, sizeof(errorMessage), "Can't pass this %s as parameter %d of '%s', it takes a '%s'", luaL_typename(L, luaArgIdx),
+						i, methodToInvoke.get_name().to_string().c_str(), nativeParamType.get_name().to_string().c_str());
+					break;
+				}
+				nativeArgs[i] = objectVals.back();
+				break;
 			}
-			else
+			default:
+				snprintf(errorMessage, sizeof(errorMessage), "Don't know this lua type '%s', parameter %d when calling '%s'", 
+					lua_typename(L, luaType), 
+					i,
+					methodToInvoke.get_name().to_string().c_str());
+				break;
+			}
+			if (errorMessage[0] != '\0')
 			{
-				printf("unrecognised parameter type '%s'\n", nativeParamType.get_name().to_string().c_str());
-				assert(false);
+				break;
 			}
-			break;
-		default:
-			luaL_error(L, "Don't know this lua type '%s', parameter %d when calling '%s'", 
-				lua_typename(L, luaType), 
-				i,
-				methodToInvoke.get_name().to_string().c_str());
-			break;
 		}
+		if (errorMessage[0] == '\0')
+		{
+			executeStart = recordStats ? BindingStatsNow() : 0;
+			result = methodToInvoke.invoke_variadic(object, nativeArgs);
+		}
+	}
+	if (errorMessage[0] != '\0')
+	{
+		luaL_error(L, "%s", errorMessage);
+	}
+	ProfileNativeCall(L);
+	const uint64_t pushStart = recordStats ? BindingStatsNow() : 0;
+
+	int numResults = 0;
+	if (result.is_type<PendingResult>())
+	{
+		numResults = WaitOnPendingResult(L, result.get_value<PendingResult>());
 	}
-	rttr::variant result = methodToInvoke.invoke_variadic(object, nativeArgs);
-	return ToLua(L, result);
+	else
+	{
+		numResults = ToLua(L, result);
+	}
+
+	if (recordStats || recordTrace)
+	{
+		const uint64_t end = BindingStatsNow();
+		if (recordStats)
+		{
+			RecordBindingCall(methodToInvoke, marshalStart, executeStart, pushStart, end);
+		}
+		if (recordTrace)
+		{
+			rttr::string_view name = methodToInvoke.get_name();
+			RecordTraceSpan(name.data(), name.size(), "native", marshalStart, end);
+		}
+	}
+	return numResults;
 }
 
 int CallGlobalFromLua(lua_State* L)
@@ -109,7 +286,22 @@ int CallGlobalFromLua(lua_State* L)
 	rttr::method* m = (rttr::method*)lua_touserdata(L, lua_upvalueindex(1));
 	rttr::method& methodToInvoke(*m);
 	rttr::instance object = {};
-	return InvokeMethod(L, methodToInvoke, object);
+	int numResults = InvokeMethod(L, methodToInvoke, object);
+	return numResults == PENDING_RESULT ? YieldForPendingResult(L) : numResults;
+}
+
+const rttr::method* GetBoundMethod( lua_State* L, int index )
+{
+	lua_CFunction f = lua_tocfunction( L, index );
+	if ( f != CallGlobalFromLua && f != InvokeFuncOnUserDatum )
+	{
+		return nullptr;
+	}
+	//a light userdata for globals & member functions
+	lua_getupvalue( L, index, 1 );
+	const rttr::method* m = (const rttr::method*)lua_touserdata( L, -1 );
+	lua_pop( L, 1 );
+	return m;
 }
 
 /*! \return The meta table name for type t */
@@ -128,13 +320,108 @@ std::string MetaTableName( const rttr::type& t )
 	return metaTableName;
 }
 
+uint32_t TypeId( const rttr::type& t )
+{
+	return (uint32_t)t.get_id();
+}
+
+/*! \brief For each class with base classes, a bit set of its ancestors by TypeId, indexed by its TypeId */
+static std::vector<std::vector<uint64_t>> MakeAncestorTable()
+{
+	std::vector<std::vector<uint64_t>> ancestors;
+	std::vector<rttr::type> toVisit;
+	for ( const rttr::type& t : rttr::type::get_types() )
+	{
+		if ( t.get_base_classes().empty() )
+		{
+			continue;	//only a match for itself, which IsA checks first
+		}
+		uint32_t typeId = TypeId( t );
+		if ( typeId >= ancestors.size() )
+		{
+			ancestors.resize( typeId + 1 );
+		}
+		std::vector<uint64_t>& bits = ancestors[typeId];
+		toVisit.assign( 1, t );
+		while ( toVisit.empty() == false )
+		{
+			rttr::type derived = toVisit.back();
+			toVisit.pop_back();
+			for ( const rttr::type& base : derived.get_base_classes() )
+			{
+				uint32_t baseId = TypeId( base );
+				if ( baseId / 64 >= bits.size() )
+				{
+					bits.resize( baseId / 64 + 1, 0 );
+				}
+				bits[baseId / 64] |= 1ull << ( baseId % 64 );
+				toVisit.push_back( base );
+			}
+		}
+	}
+	return ancestors;
+}
+
+bool IsA( uint32_t typeId, uint32_t baseTypeId )
+{
+	if ( typeId == baseTypeId )
+	{
+		return true;
+	}
+	//the classes are all registered before main, so this is made after them
+	static const std::vector<std::vector<uint64_t>> s_ancestors = MakeAncestorTable();
+	if ( typeId >= s_ancestors.size() )
+	{
+		return false;
+	}
+	const std::vector<uint64_t>& bits = s_ancestors[typeId];
+	return baseTypeId / 64 < bits.size() && ( ( bits[baseTypeId / 64] >> ( baseTypeId % 64 ) ) & 1 ) != 0;
+}
+
+/*! \return the bound object at #idx if its class is #typeId or derived from it, otherwise nullptr */
+static UserDatum* ToUserDatumOfClass( lua_State* L, int idx, uint32_t typeId )
+{
+	if ( lua_type( L, idx ) != LUA_TUSERDATA || lua_rawlen( L, idx ) != sizeof( UserDatum ) )
+	{
+		return nullptr;
+	}
+	UserDatum* ud = (UserDatum*)lua_touserdata( L, idx );
+	if ( ud->m_magic != USER_DATUM_MAGIC )
+	{
+		return nullptr;
+	}
+	return IsA( ud->m_typeId, typeId ) ? ud : nullptr;
+}
+
+UserDatum* ToUserDatum( lua_State* L, int idx, const rttr::type& t )
+{
+	return ToUserDatumOfClass( L, idx, TypeId( t.get_raw_type() ) );
+}
+
+/*! \return the most derived class of the object in #v, held by value, pointer or smart pointer */
+static rttr::type ObjectClass( const rttr::variant& v )
+{
+	rttr::type t = rttr::instance( v ).get_derived_type();
+	if ( t.is_valid() == false )
+	{
+		t = v.get_type();
+	}
+	if ( t.is_wrapper() )
+	{
+		t = t.get_wrapped_type();
+	}
+	return t.get_raw_type();
+}
+
 int CreateUserDatumFromVariant( lua_State* L, const rttr::variant& v )
 {
-	void* ud = lua_newuserdata( L, sizeof( rttr::variant ) );
+	void* ud = lua_newuserdata( L, sizeof( UserDatum ) );
 	int userDatumStackIndex = lua_gettop( L );
-	new (ud) rttr::variant( v );
+	rttr::type objectClass = ObjectClass( v );
+	new (ud) UserDatum{ v, NOT_DIRTY, USER_DATUM_MAGIC, TypeId( objectClass ) };
 
-	luaL_getmetatable( L, MetaTableName( v.get_type() ).c_str() );
+	//the most derived class's metatable, so a Sprite* to an AnimatedSprite has all its members
+	PushMetaTable( L, objectClass );
 	lua_setmetatable( L, userDatumStackIndex );
 
 	lua_newtable( L );
@@ -148,11 +435,10 @@ int CreateUserDatum(lua_State* L)
 	const char* typeName = (const char*)lua_tostring(L, lua_upvalueindex(1));
 	rttr::type typeToCreate = rttr::type::get_by_name(typeName);
 
-	void* ud = lua_newuserdata(L, sizeof(rttr::variant) );
-	new (ud) rttr::variant(typeToCreate.create());
-	//rttr::variant& variant = *(rttr::variant*)ud;
+	void* ud = lua_newuserdata(L, sizeof(UserDatum) );
+	new (ud) UserDatum{ typeToCreate.create(), NOT_DIRTY, USER_DATUM_MAGIC, TypeId( typeToCreate ) };
 
-	luaL_getmetatable(L, MetaTableName(typeToCreate).c_str());
+	PushMetaTable(L, typeToCreate);
 	lua_setmetatable(L, 1);
 
 	lua_newtable(L);
@@ -163,57 +449,259 @@ int CreateUserDatum(lua_State* L)
 
 int DestroyUserDatum(lua_State* L)
 {
-	rttr::variant* ud = (rttr::variant*)lua_touserdata(L, -1);
-	ud->~variant();
+	UserDatum* ud = (UserDatum*)lua_touserdata(L, -1);
+	ForgetDirty(L, ud);
+	ud->~UserDatum();
+	return 0;
+}
+
+/*! \brief __gc for types registered with DEFERRED_DESTROY, the native object is queued to be destroyed later */
+int DeferDestroyUserDatum(lua_State* L)
+{
+	UserDatum* ud = (UserDatum*)lua_touserdata(L, -1);
+	ForgetDirty(L, ud);
+	DeferDestruction(std::move(ud->m_object));
+	ud->~UserDatum();		//just the moved from husk
 	return 0;
 }
 
+/*! \brief Every method & property of a class, its base classes' included, sorted by HashName.
+*	Made once per class per process, the first time the class is bound, so finding a member never walks the hierarchy. */
+struct ClassMembers
+{
+	struct Member
+	{
+		uint32_t hash;
+		std::string name;
+		int index;			//in to methods or properties
+		bool isMethod;
+	};
+
+	uint32_t typeId;		//TypeId of the class
+	std::vector<rttr::method> methods;
+	std::vector<rttr::property> properties;
+	std::vector<Member> members;
+
+	const Member* Find( const char* name, size_t length ) const
+	{
+		uint32_t hash = HashName( name, length );
+		auto it = std::lower_bound( members.begin(), members.end(), hash, []( const Member& member, uint32_t h )
+		{
+			return member.hash < h;
+		} );
+		for ( ; it != members.end() && it->hash == hash; ++it )
+		{
+			if ( it->name.size() == length && it->name.compare( 0, length, name, length ) == 0 )
+			{
+				return &*it;
+			}
+		}
+		return nullptr;
+	}
+};
+
+static const ClassMembers* GetClassMembers( const rttr::type& t )
+{
+	static std::mutex s_classMembersMutex;
+	static std::unordered_map<uint32_t, std::unique_ptr<ClassMembers>> s_classMembers;
+
+	std::lock_guard<std::mutex> lock( s_classMembersMutex );
+	std::unique_ptr<ClassMembers>& classMembers = s_classMembers[TypeId( t )];
+	if ( classMembers )
+	{
+		return classMembers.get();
+	}
+
+	classMembers.reset( new ClassMembers );
+	ClassMembers& cm = *classMembers;
+	cm.typeId = TypeId( t );
+	auto isNew = [&cm]( rttr::string_view name )
+	{
+		return std::none_of( cm.members.begin(), cm.members.end(), [&name]( const ClassMembers::Member& member )
+		{
+			return name == member.name;
+		} );
+	};
+	auto addMembersOf = [&cm, &isNew]( const rttr::type& from )
+	{
+		for ( const rttr::method& m : from.get_methods() )
+		{
+			rttr::string_view name = m.get_name();
+			if ( isNew( name ) )
+			{
+				cm.members.push_back( { HashName( name.data(), name.size() ), name.to_string(), (int)cm.methods.size(), true } );
+				cm.methods.push_back( m );
+			}
+		}
+		for ( const rttr::property& p : from.get_properties() )
+		{
+			rttr::string_view name = p.get_name();
+			if ( isNew( name ) )
+			{
+				cm.members.push_back( { HashName( name.data(), name.size() ), name.to_string(), (int)cm.properties.size(), false } );
+				cm.properties.push_back( p );
+			}
+		}
+	};
+
+	//the class first, so its members hide any of the same name in a base class
+	addMembersOf( t );
+	for ( const rttr::type& base : t.get_base_classes() )
+	{
+		addMembersOf( base );
+	}
+	std::sort( cm.members.begin(), cm.members.end(), []( const ClassMembers::Member& a, const ClassMembers::Member& b )
+	{
+		return a.hash < b.hash;
+	} );
+	return classMembers.get();
+}
+
+/*! \brief The ClassMembers of a class in the build time manifest, made from its sorted member tables (which
+*	already hold the inherited members) the first time the class is bound in the process, so binding it in
+*	later states doesn't look the class up by name or walk its rttr members */
+static const ClassMembers* ManifestClassMembers( const ManifestClass& manifestClass )
+{
+	static std::mutex s_manifestMembersMutex;
+	static std::unordered_map<const ManifestClass*, std::unique_ptr<ClassMembers>> s_manifestMembers;
+
+	std::lock_guard<std::mutex> lock( s_manifestMembersMutex );
+	std::unique_ptr<ClassMembers>& classMembers = s_manifestMembers[&manifestClass];
+	if ( classMembers )
+	{
+		return classMembers.get();
+	}
+
+	rttr::type t = rttr::type::get_by_name( manifestClass.name );
+	classMembers.reset( new ClassMembers );
+	ClassMembers& cm = *classMembers;
+	cm.typeId = TypeId( t );
+	for ( int i = 0; i < manifestClass.numMethods; i++ )
+	{
+		const ManifestMember& member = manifestClass.methods[i];
+		cm.members.push_back( { member.hash, member.name, (int)cm.methods.size(), true } );
+		cm.methods.push_back( t.get_method( member.name ) );
+		assert( cm.methods.back().is_valid() );		//the manifest is out of date
+	}
+	for ( int i = 0; i < manifestClass.numProperties; i++ )
+	{
+		const ManifestMember& member = manifestClass.properties[i];
+		cm.members.push_back( { member.hash, member.name, (int)cm.properties.size(), false } );
+		cm.properties.push_back( t.get_property( member.name ) );
+		assert( cm.properties.back().is_valid() );
+	}
+	//each table is sorted, merge them
+	std::inplace_merge( cm.members.begin(), cm.members.begin() + manifestClass.numMethods, cm.members.end(),
+		[]( const ClassMembers::Member& a, const ClassMembers::Member& b )
+	{
+		return a.hash < b.hash;
+	} );
+	return classMembers.get();
+}
+
 int InvokeFuncOnUserDatum(lua_State* L)
 {
 	rttr::method& m = *(rttr::method*)lua_touserdata(L, lua_upvalueindex(1));
-	if (lua_isuserdata(L, 1) == false)
+	//the method can be called with anything, e.g. local mv = spr.Move; mv(Buffer.new("int16", 0), 1, 1)
+	UserDatum* ud = ToUserDatum(L, 1, m.get_declaring_type());
+	if (ud == nullptr)
 	{
-		luaL_error(L, "Expected a userdatum on the lua stack when invoking native method '%s'", m.get_name().to_string().c_str());
+		rttr::string_view name = m.get_name();
+		lua_pushlstring(L, name.data(), name.size());	//not a std::string, luaL_error wouldn't free it
+		luaL_error(L, "Expected a bound object as self when invoking native method '%s', got a %s", lua_tostring(L, -1), luaL_typename(L, 1));
 	}
 
-	rttr::variant& ud = *(rttr::variant*)lua_touserdata(L, 1);
-	rttr::instance object(ud);
-	return InvokeMethod(L, m, object);
+	if (lua_toboolean(L, lua_upvalueindex(2)))
+	{
+		MarkDirty(L, ud);	//before the call, which can yield or error
+	}
+	rttr::instance object(ud->m_object);
+	int numResults = InvokeMethod(L, m, object);
+	return numResults == PENDING_RESULT ? YieldForPendingResult(L) : numResults;
 }
 
-int IndexUserDatum(lua_State* L)
+/*! \brief Pushes what the field named at stack index 2 is on the metamethod's class, from the class's member cache
+*	(upvalue 4) keyed by the interned Lua string, so the class's ClassMembers (upvalue 2) are only searched
+*	the first time a name is used:
+*	- the InvokeFuncOnUserDatum closure for a method
+*	- a userdata holding the rttr::property for a property
+*	- false for anything else, which lives in the uservalue. These aren't cached, the cache is shared by every
+*	  instance of the class & would otherwise grow with every uservalue key any script uses, e.g. spr["k"..i]
+*	\return the Lua type of what was pushed */
+static int PushMember(lua_State* L)
 {
-	const char* typeName = (const char*)lua_tostring(L, lua_upvalueindex(1));
-	rttr::type typeInfo = rttr::type::get_by_name(typeName);
-	if (lua_isuserdata(L, 1) == false)
+	lua_pushvalue(L, 2);
+	int memberType = lua_rawget(L, lua_upvalueindex(4));
+	if (memberType != LUA_TNIL)
 	{
-		luaL_error(L, "Expected a userdatum on the lua stack when indexing native type '%s'", typeName);
+		return memberType;
 	}
+	lua_pop(L, 1);
 
-	if (lua_isstring(L, 2) == false)
+	size_t fieldNameLength = 0;
+	const char* fieldName = lua_tolstring(L, 2, &fieldNameLength);
+	const ClassMembers* classMembers = (const ClassMembers*)lua_touserdata(L, lua_upvalueindex(2));
+	const ClassMembers::Member* member = classMembers->Find(fieldName, fieldNameLength);
+	if (member && member->isMethod)
 	{
-		luaL_error(L, "Expected a name of a native property or method when indexing native type '%s'", typeName);
+		//the ClassMembers live as long as the process, so the closure can point straight at the method
+		rttr::method& m = const_cast<rttr::method&>(classMembers->methods[member->index]);
+		lua_pushlightuserdata(L, &m);
+		lua_pushboolean(L, lua_toboolean(L, lua_upvalueindex(3)) && MethodMarksDirty(m));
+		lua_pushcclosure(L, InvokeFuncOnUserDatum, 2);
+	}
+	else if (member)
+	{
+		void* propertyUD = lua_newuserdata(L, sizeof(rttr::property));
+		new (propertyUD) rttr::property(classMembers->properties[member->index]);
 	}
+	else
+	{
+		lua_pushboolean(L, false);
+		return LUA_TBOOLEAN;
+	}
+	lua_pushvalue(L, 2);
+	lua_pushvalue(L, -2);
+	lua_rawset(L, lua_upvalueindex(4));
+	return lua_type(L, -1);
+}
 
-	const char* fieldName = lua_tostring(L, 2);
-	rttr::method m = typeInfo.get_method(fieldName);
-	if (m.is_valid())
+int IndexUserDatum(lua_State* L)
+{
+	//the metamethod can be called directly through getmetatable(ud).__index, with anything
+	const ClassMembers* classMembers = (const ClassMembers*)lua_touserdata(L, lua_upvalueindex(2));
+	UserDatum* ud = ToUserDatumOfClass(L, 1, classMembers->typeId);
+	if (ud == nullptr)
 	{
-		void* methodUD = lua_newuserdata(L, sizeof(rttr::method));
-		new (methodUD) rttr::method(m);
-		lua_pushcclosure(L, InvokeFuncOnUserDatum, 1);
-		return 1;
+		luaL_error(L, "Expected a userdatum on the lua stack when indexing native type '%s'", lua_tostring(L, lua_upvalueindex(1)));
 	}
 
-	rttr::property p = typeInfo.get_property(fieldName);
-	if (p.is_valid())
+	if (lua_isstring(L, 2) == false)
+	{
+		luaL_error(L, "Expected a name of a native property or method when indexing native type '%s'", lua_tostring(L, lua_upvalueindex(1)));
+	}
+
+	switch (PushMember(L))
 	{
-		rttr::variant& ud = *(rttr::variant*)lua_touserdata(L, 1);
-		rttr::variant result = p.get_value(ud);
+	case LUA_TFUNCTION:
+		return 1;	//the method
+	case LUA_TUSERDATA:
+	{
+		const rttr::property& p = *(const rttr::property*)lua_touserdata(L, -1);
+		rttr::variant result = p.get_value(ud->m_object);
+		if (result.is_valid() && IsViewableContainer(result))
+		{
+			//viewed in place when bound as a pointer, a by value property is a copy so its view is read only
+			return PushContainerView(L, result, 1, result.get_type().is_pointer() == false);
+		}
 		if (result.is_valid())
 		{
 			return ToLua(L, result);
 		}
+		break;
+	}
+	default:
+		break;
 	}
 
 	//if it's not a method or property then return the uservalue
@@ -226,8 +714,9 @@ int IndexUserDatum(lua_State* L)
 int NewIndexUserDatum(lua_State* L)
 {
 	const char* typeName = (const char*)lua_tostring(L, lua_upvalueindex(1));
-	rttr::type typeInfo = rttr::type::get_by_name(typeName);
-	if (lua_isuserdata(L, 1) == false)
+	const ClassMembers* classMembers = (const ClassMembers*)lua_touserdata(L, lua_upvalueindex(2));
+	UserDatum* userDatum = ToUserDatumOfClass(L, 1, classMembers->typeId);
+	if (userDatum == nullptr)
 	{
 		luaL_error(L, "Expected a userdatum on the lua stack when indexing native type '%s'", typeName);
 	}
@@ -239,11 +728,11 @@ int NewIndexUserDatum(lua_State* L)
 
 	// 3 - the value we are writing to the object
 
-	const char* fieldName = lua_tostring(L, 2);
-	rttr::property p = typeInfo.get_property(fieldName);
-	if (p.is_valid())
+	if (PushMember(L) == LUA_TUSERDATA)
 	{
-		rttr::variant& ud = *(rttr::variant*)lua_touserdata(L, 1);
+		const rttr::property& p = *(const rttr::property*)lua_touserdata(L, -1);
+		const char* fieldName = lua_tostring(L, 2);
+		rttr::variant& ud = userDatum->m_object;
 		int luaType = lua_type(L, 3);
 		switch (luaType)
 		{
@@ -251,12 +740,16 @@ int NewIndexUserDatum(lua_State* L)
 			if (p.get_type() == rttr::type::get<int>())
 			{
 				int val = (int)lua_tonumber(L, 3);
-				assert( p.set_value(ud, val) );
+				bool wasSet = p.set_value(ud, val);	//not inside the assert, or release builds never set it
+				assert(wasSet);
+				(void)wasSet;
 			}
 			else if (p.get_type() == rttr::type::get<short>())
 			{
 				short val = (short)lua_tonumber(L, 3);
-				assert(p.set_value(ud, val));
+				bool wasSet = p.set_value(ud, val);
+				assert(wasSet);
+				(void)wasSet;
 			}
 			else
 			{
@@ -265,6 +758,23 @@ int NewIndexUserDatum(lua_State* L)
 					fieldName, typeName, p.get_type().get_name().to_string().c_str() );
 			}
 			break;
+		case LUA_TSTRING:
+			//only std::string, a const char* or view would point at a Lua string that can be collected
+			if (p.get_type() == rttr::type::get<std::string>())
+			{
+				size_t length = 0;
+				const char* str = lua_tolstring(L, 3, &length);
+				bool wasSet = p.set_value(ud, std::string(str, length));
+				assert(wasSet);
+				(void)wasSet;
+			}
+			else
+			{
+				luaL_error(L, 
+					"Cannot set the value '%s' on this type '%s' from a string, it's a '%s'", 
+					fieldName, typeName, p.get_type().get_name().to_string().c_str() );
+			}
+			break;
 		default:
 			luaL_error(L, 
 				"Cannot set the value '%s' on this type '%s', we didnt recognise the lua type '%s'", 
@@ -272,6 +782,10 @@ int NewIndexUserDatum(lua_State* L)
 			break;
 		}
 
+		if (lua_toboolean(L, lua_upvalueindex(3)))
+		{
+			MarkDirty(L, userDatum);
+		}
 		return 0;
 	}
 
@@ -283,57 +797,243 @@ int NewIndexUserDatum(lua_State* L)
 	return 0;
 }
 
-lua_State* CreateScript( ArenaAllocator& pool )
+/*! \brief Creates the metatable & metamethods for a class, if it hasn't been made already
+*	\param manifestClass the class in the BindingManifest, can be nullptr */
+void BindMetaTable( lua_State* L, const char* typeName, const char* metaTableName, const ManifestClass* manifestClass )
 {
-	//open the Lua state using our memory pool
-	lua_State* L = lua_newstate( ArenaAllocator::l_alloc, &pool );
+	if ( luaL_getmetatable( L, metaTableName ) != LUA_TNIL )
+	{
+		lua_pop( L, 1 );	//already bound
+		return;
+	}
+	lua_pop( L, 1 );
 
-	lua_newtable( L );
-	lua_pushvalue( L, -1 );
-	lua_setglobal( L, "Global" );
+	//same as luaL_newmetatable, but sized up front
+	lua_createtable( L, 0, 4 );
+	lua_pushstring( L, metaTableName );
+	lua_setfield( L, -2, "__name" );
 
-	//binding global methods
-	lua_pushvalue( L, -1 );											//1
-	for ( auto& method : rttr::type::get_global_methods() )
+	//the destruction policy is decided once here, not on every collection
+	bool deferredDestroy = manifestClass ? manifestClass->deferredDestroy : HasDeferredDestruction( rttr::type::get_by_name( typeName ) );
+	lua_pushstring( L, "__gc" );
+	lua_pushcfunction( L, deferredDestroy ? DeferDestroyUserDatum : DestroyUserDatum );
+	lua_settable( L, -3 );
+
+	bool dirtyTracked = manifestClass ? manifestClass->dirtyTracked : HasDirtyTracking( rttr::type::get_by_name( typeName ) );
+	const ClassMembers* classMembers = manifestClass ? ManifestClassMembers( *manifestClass ) : GetClassMembers( rttr::type::get_by_name( typeName ) );
+	lua_newtable( L );		//the member cache, see PushMember
+	int memberCacheIdx = lua_gettop( L );
+
+	lua_pushstring( L, "__index" );
+	lua_pushstring( L, typeName );
+	lua_pushlightuserdata( L, (void*)classMembers );
+	lua_pushboolean( L, dirtyTracked );
+	lua_pushvalue( L, memberCacheIdx );
+	lua_pushcclosure( L, IndexUserDatum, 4 );
+	lua_settable( L, -4 );
+
+	lua_pushstring( L, "__newindex" );
+	lua_pushstring( L, typeName );
+	lua_pushlightuserdata( L, (void*)classMembers );
+	lua_pushboolean( L, dirtyTracked );
+	lua_pushvalue( L, memberCacheIdx );
+	lua_pushcclosure( L, NewIndexUserDatum, 4 );
+	lua_settable( L, -4 );
+	lua_pop( L, 1 );
+
+	lua_setfield( L, LUA_REGISTRYINDEX, metaTableName );
+}
+
+/*! \brief Creates the global table for a class with its constructor, and its metatable.
+*	Leaves the class table on the stack. */
+void BindClass( lua_State* L, const char* typeName, const char* metaTableName, const ManifestClass* manifestClass )
+{
+	lua_createtable( L, 0, 1 );
+	lua_pushglobaltable( L );
+	lua_pushstring( L, typeName );
+	lua_pushvalue( L, -3 );
+	lua_rawset( L, -3 );		//_G[typeName] = class table, raw so we don't go through a lazy __index
+	lua_pop( L, 1 );
+
+	lua_pushstring( L, typeName );
+	lua_pushcclosure( L, CreateUserDatum, 1 );
+	lua_setfield( L, -2, "new" );
+
+	BindMetaTable( L, typeName, metaTableName, manifestClass );
+}
+
+/*! \return #classToRegister in the build time manifest, nullptr if there isn't one */
+const ManifestClass* FindManifestClass( const rttr::type& classToRegister )
+{
+	const BindingManifest* manifest = GetBindingManifest();
+	if ( manifest == nullptr )
 	{
-		lua_pushstring( L, method.get_name().to_string().c_str() );	//2
-		lua_pushlightuserdata( L, ( void* )&method );
-		lua_pushcclosure( L, CallGlobalFromLua, 1 );					//3 
-		lua_settable( L, -3 );										//1[2] = 3
+		return nullptr;
 	}
+	rttr::string_view name = classToRegister.get_name();
+	return FindManifestClass( *manifest, name.data(), name.size() );
+}
 
-	//binding classes to Lua
-	for ( auto& classToRegister : rttr::type::get_types() )
+/*! \brief Binds #classToRegister from the manifest if we have it, otherwise from rttr.
+*	Leaves the class table on the stack. */
+void BindClass( lua_State* L, const rttr::type& classToRegister )
+{
+	if ( const ManifestClass* manifestClass = FindManifestClass( classToRegister ) )
 	{
-		if ( classToRegister.is_class() )
+		BindClass( L, manifestClass->name, manifestClass->metaTableName, manifestClass );
+	}
+	else
+	{
+		BindClass( L, classToRegister.get_name().to_string().c_str(), MetaTableName( classToRegister ).c_str(), nullptr );
+	}
+}
+
+/*! \brief Pushes the metatable for objects of type #t, binding it first if need be */
+void PushMetaTable( lua_State* L, const rttr::type& t )
+{
+	rttr::type classType = t.is_pointer() ? t.get_raw_type() : t;
+	if ( const ManifestClass* manifestClass = FindManifestClass( classType ) )
+	{
+		//no MetaTableName string to build when we have the manifest
+		if ( luaL_getmetatable( L, manifestClass->metaTableName ) == LUA_TNIL )
 		{
-			const std::string s = classToRegister.get_name().to_string();
-			const char* typeName = s.c_str();
+			//with BindingMode::Lazy we might not have seen this type yet
+			lua_pop( L, 1 );
+			BindMetaTable( L, manifestClass->name, manifestClass->metaTableName, manifestClass );
+			luaL_getmetatable( L, manifestClass->metaTableName );
+		}
+	}
+	else
+	{
+		const std::string metaTableName = MetaTableName( classType );
+		if ( luaL_getmetatable( L, metaTableName.c_str() ) == LUA_TNIL )
+		{
+			lua_pop( L, 1 );
+			BindMetaTable( L, classType.get_name().to_string().c_str(), metaTableName.c_str(), nullptr );
+			luaL_getmetatable( L, metaTableName.c_str() );
+		}
+	}
+}
 
-			lua_newtable( L );
-			lua_pushvalue( L, -1 );
-			lua_setglobal( L, classToRegister.get_name().to_string().c_str() );
+/*! \brief _G.__index for BindingMode::Lazy, binds a class the first time a script uses its name */
+int LazyBindGlobal( lua_State* L )
+{
+	// 1 - _G
+	// 2 - the name of the global
+	if ( lua_type( L, 2 ) != LUA_TSTRING )
+	{
+		return 0;
+	}
+
+	size_t nameLength = 0;
+	const char* name = lua_tolstring( L, 2, &nameLength );
+	if ( const BindingManifest* manifest = GetBindingManifest() )
+	{
+		//unknown globals are rejected with a hash lookup, rather than a search through rttr
+		const ManifestClass* manifestClass = FindManifestClass( *manifest, name, nameLength );
+		if ( manifestClass == nullptr )
+		{
+			return 0;
+		}
+		BindClass( L, manifestClass->name, manifestClass->metaTableName, manifestClass );
+		return 1;
+	}
 
-			lua_pushvalue( L, -1 );
-			lua_pushstring( L, typeName );
-			lua_pushcclosure( L, CreateUserDatum, 1 );
-			lua_setfield( L, -2, "new" );
+	rttr::type classToRegister = rttr::type::get_by_name( name );
+	if ( classToRegister.is_valid() && classToRegister.is_class() )
+	{
+		BindClass( L, classToRegister );
+		return 1;
+	}
+	return 0;
+}
+
+/*! \brief The rttr::method of each of the manifest's global methods, looked up once per process
+*	rather than every time a state is created. */
+const std::vector<rttr::method*>& ManifestGlobalMethods( const BindingManifest& manifest )
+{
+	static const std::vector<rttr::method*> methods = [&manifest]()
+	{
+		std::vector<rttr::method*> resolved( manifest.numGlobalMethods, nullptr );
+		for ( auto& method : rttr::type::get_global_methods() )
+		{
+			rttr::string_view name = method.get_name();
+			for ( int i = 0; i < manifest.numGlobalMethods; i++ )
+			{
+				if ( name == manifest.globalMethods[i].name )
+				{
+					resolved[i] = ( rttr::method* )&method;
+				}
+			}
+		}
+		return resolved;
+	}();
+	return methods;
+}
 
-			//create the metatable & metamethods for this type
-			luaL_newmetatable( L, MetaTableName( classToRegister ).c_str() );
-			lua_pushstring( L, "__gc" );
-			lua_pushcfunction( L, DestroyUserDatum );
-			lua_settable( L, -3 );
+lua_State* CreateScript( ArenaAllocator& pool, BindingMode mode )
+{
+	//open the Lua state using our memory pool
+	lua_State* L = lua_newstate( ArenaAllocator::l_alloc, &pool );
+	const BindingManifest* manifest = GetBindingManifest();
 
-			lua_pushstring( L, "__index" );
-			lua_pushstring( L, typeName );
-			lua_pushcclosure( L, IndexUserDatum, 1 );
-			lua_settable( L, -3 );
+	//binding global methods
+	if ( manifest )
+	{
+		const std::vector<rttr::method*>& methods = ManifestGlobalMethods( *manifest );
+		lua_createtable( L, 0, manifest->numGlobalMethods + 1 );	//+ BindingStats
+		for ( int i = 0; i < manifest->numGlobalMethods; i++ )
+		{
+			assert( methods[i] != nullptr );	//the manifest is out of date
+			lua_pushlightuserdata( L, methods[i] );
+			lua_pushcclosure( L, CallGlobalFromLua, 1 );
+			lua_setfield( L, -2, manifest->globalMethods[i].name );
+		}
+	}
+	else
+	{
+		lua_newtable( L );
+		for ( auto& method : rttr::type::get_global_methods() )
+		{
+			lua_pushstring( L, method.get_name().to_string().c_str() );	//2
+			lua_pushlightuserdata( L, ( void* )&method );
+			lua_pushcclosure( L, CallGlobalFromLua, 1 );					//3 
+			lua_settable( L, -3 );										//1[2] = 3
+		}
+	}
+	lua_pushcfunction( L, PushBindingStats );
+	lua_setfield( L, -2, "BindingStats" );
+	lua_setglobal( L, "Global" );
 
-			lua_pushstring( L, "__newindex" );
-			lua_pushstring( L, typeName );
-			lua_pushcclosure( L, NewIndexUserDatum, 1 );
-			lua_settable( L, -3 );
+	//binding classes to Lua
+	if ( mode == BindingMode::Lazy )
+	{
+		//bound on first use by LazyBindGlobal & PushMetaTable
+		lua_pushglobaltable( L );
+		lua_newtable( L );
+		lua_pushcfunction( L, LazyBindGlobal );
+		lua_setfield( L, -2, "__index" );
+		lua_setmetatable( L, -2 );
+		lua_pop( L, 1 );
+	}
+	else if ( manifest )
+	{
+		for ( int i = 0; i < manifest->numClasses; i++ )
+		{
+			const ManifestClass& manifestClass = manifest->classes[i];
+			BindClass( L, manifestClass.name, manifestClass.metaTableName, &manifestClass );
+			lua_pop( L, 1 );
+		}
+	}
+	else
+	{
+		for ( auto& classToRegister : rttr::type::get_types() )
+		{
+			if ( classToRegister.is_class() )
+			{
+				BindClass( L, classToRegister );
+				lua_pop( L, 1 );
+			}
 		}
 	}
 
@@ -342,11 +1042,20 @@ lua_State* CreateScript( ArenaAllocator& pool )
 
 int LoadScript( lua_State* L, const char* script )
 {
+	ScopedTraceSpan span( "LoadScript", "script" );
 	return luaL_loadstring( L, script );
 }
 
 int ExecuteScript( lua_State* L )
 {
+	ScopedTraceSpan span( "ExecuteScript", "script" );
+	if ( PerfCountersEnabled() )
+	{
+		PerfSample start = ReadPerfCounters();
+		int result = lua_pcall( L, 0, LUA_MULTRET, 0 );
+		RecordScriptRun( "ExecuteScript", ReadPerfCounters() - start );
+		return result;
+	}
 	return lua_pcall( L, 0, LUA_MULTRET, 0 );
 }
 
@@ -1,14 +1,58 @@
 #pragma once
 #include "lua.hpp"
 #include <rttr/registration>
+#include "BindingStats.h"
+#include "PerfCounters.h"
+#include "ScriptTrace.h"
 
 struct ArenaAllocator;
 
-lua_State* CreateScript( ArenaAllocator& pool );
+/*! \brief How CreateScript binds the classes registered with rttr */
+enum class BindingMode
+{
+	Eager,	//every class is bound when the state is created
+	Lazy,	//a class is bound the first time a script uses its name, or an instance of it is sent to Lua
+};
+
+lua_State* CreateScript( ArenaAllocator& pool, BindingMode mode = BindingMode::Eager );
 int LoadScript( lua_State* L, const char* script );
 int ExecuteScript( lua_State* L );
 void CloseScript( lua_State* L );
 
+/*! \brief The memory of every userdata made by the binding, the object first */
+struct UserDatum
+{
+	rttr::variant m_object;
+	uint32_t m_dirtyIdx;	//where it is in the dirty list, NOT_DIRTY if it isn't (see DirtyTracking.h)
+	uint32_t m_magic;		//USER_DATUM_MAGIC, tells a UserDatum from other userdata without looking at its metatable
+	uint32_t m_typeId;		//TypeId() of the object's most derived class
+};
+
+constexpr uint32_t NOT_DIRTY = 0xffffffffu;
+constexpr uint32_t USER_DATUM_MAGIC = 0x4c554454u;
+
+/*! \return a small integer naming #t, the same for the life of the process */
+uint32_t TypeId( const rttr::type& t );
+
+/*! \return true if #typeId is #baseTypeId or a class derived from it.
+*	O(1), a bit test in a table made from the rttr registrations the first time it is called. */
+bool IsA( uint32_t typeId, uint32_t baseTypeId );
+
+/*! \return the bound object at #idx if it is a #t or derived from one, otherwise nullptr */
+UserDatum* ToUserDatum( lua_State* L, int idx, const rttr::type& t );
+
+template< typename T >
+inline UserDatum* ToUserDatum( lua_State* L, int idx )
+{
+	return ToUserDatum( L, idx, rttr::type::get<T>() );
+}
+
+/*! \return The meta table name for type t */
+std::string MetaTableName( const rttr::type& t );
+
+/*! \return the rttr method bound to the native function at #index, or nullptr if it isn't a bound method */
+const rttr::method* GetBoundMethod( lua_State* L, int index );
+
 /*! \brief Takes the result and puts it onto the Lua stack
 *	\return the number of values left on the stack. */
 int ToLua( lua_State* L, rttr::variant& result );
@@ -45,11 +89,28 @@ inline int PutOnLuaStack( lua_State* L, T& toPutOnStack, T2&... moreArgs )
 template< typename... ARGS >
 inline void CallScriptFunction( lua_State* L, const char* funcName, ARGS&... args )
 {
+	//not a ScopedTraceSpan, luaL_error would longjmp past its destructor
+	const uint64_t traceStart = TracingEnabled() ? TraceNow() : 0;
+	const bool countPerf = PerfCountersEnabled();
 	lua_getglobal( L, funcName );
 	if ( lua_type( L, -1 ) == LUA_TFUNCTION )
 	{
 		int numArgs = PutOnLuaStack( L, args... );
-		if ( lua_pcall( L, numArgs, 0, 0 ) != 0 )
+		PerfSample perfStart;
+		if ( countPerf )
+		{
+			perfStart = ReadPerfCounters();
+		}
+		int result = lua_pcall( L, numArgs, 0, 0 );
+		if ( countPerf )
+		{
+			RecordScriptRun( funcName, ReadPerfCounters() - perfStart );
+		}
+		if ( traceStart )
+		{
+			RecordTraceSpan( funcName, strlen( funcName ), "script", traceStart, TraceNow() );
+		}
+		if ( result != 0 )
 		{
 			printf( "unable to call script function '%s', '%s'\n", funcName, lua_tostring( L, -1 ) );
 			luaL_error( L, "unable to call script function '%s', '%s'", funcName, lua_tostring( L, -1 ) );
@@ -0,0 +1,25 @@
+#include "BindingManifest.h"
+#include <algorithm>
+#include <string.h>
+
+/*! \return true if the null terminated #a is the same as #b of #length */
+static bool NameEquals( const char* a, const char* b, size_t length )
+{
+	return strncmp( a, b, length ) == 0 && a[length] == '\0';
+}
+
+const ManifestClass* FindManifestClass( const BindingManifest& manifest, const char* name, size_t length )
+{
+	const uint32_t hash = HashName( name, length );
+	const ManifestClass* end = manifest.classes + manifest.numClasses;
+	const ManifestClass* it = std::lower_bound( manifest.classes, end, hash,
+		[]( const ManifestClass& c, uint32_t h ) { return c.hash < h; } );
+	for ( ; it != end && it->hash == hash; ++it )
+	{
+		if ( NameEquals( it->name, name, length ) )
+		{
+			return it;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// The binding manifest is generated at build time by LuaBindingManifestGen from the rttr registrations,
+// so CreateScript can fill a state from these flat arrays instead of walking the reflection database.
+
+/*! \brief A method or property name & its HashName, tables of these are sorted by hash */
+struct ManifestMember
+{
+	const char* name;
+	uint32_t hash;
+};
+
+struct ManifestClass
+{
+	const char* name;
+	const char* metaTableName;		//MetaTableName() of the class
+	uint32_t hash;
+	const ManifestMember* methods;	//sorted by hash, the inherited ones included
+	int numMethods;
+	const ManifestMember* properties;	//sorted by hash, the inherited ones included
+	int numProperties;
+	bool deferredDestroy;			//registered with the DEFERRED_DESTROY metadata
+	bool dirtyTracked;				//registered with the DIRTY_TRACKED metadata
+};
+
+struct BindingManifest
+{
+	const ManifestMember* globalMethods;
+	int numGlobalMethods;
+	const ManifestClass* classes;		//sorted by hash
+	int numClasses;
+};
+
+/*! \return the manifest generated at build time, or nullptr if this build doesn't have one */
+const BindingManifest* GetBindingManifest();
+
+/*! \brief 32 bit FNV-1a hash of a name */
+inline uint32_t HashName( const char* name, size_t length )
+{
+	uint32_t hash = 2166136261u;
+	for ( size_t i = 0; i < length; i++ )
+	{
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*! \return the class called #name, or nullptr if it isn't in the manifest */
+const ManifestClass* FindManifestClass( const BindingManifest& manifest, const char* name, size_t length );
@@ -0,0 +1,156 @@
+#include "AutomatedBinding.h"
+#include "BindingManifest.h"
+#include "DeferredDestruction.h"
+#include "DirtyTracking.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Build tool, walks the rttr registrations linked into it and writes them out
+// as a BindingManifest for LuaTutorial to compile in.
+// usage: LuaBindingManifestGen <output.cpp>
+
+struct Member
+{
+	std::string name;
+	uint32_t hash;
+};
+
+static Member MakeMember( const std::string& name )
+{
+	return { name, HashName( name.c_str(), name.size() ) };
+}
+
+/*! \brief Sort by hash & remove duplicate names (overloads are bound by name, so only one entry is needed) */
+static void SortMembers( std::vector<Member>& members )
+{
+	std::sort( members.begin(), members.end(), []( const Member& a, const Member& b )
+	{
+		return a.hash != b.hash ? a.hash < b.hash : a.name < b.name;
+	} );
+	members.erase( std::unique( members.begin(), members.end(), []( const Member& a, const Member& b )
+	{
+		return a.name == b.name;
+	} ), members.end() );
+}
+
+/*! \brief Writes a ManifestMember array, \return the name of the array or nullptr if it is empty */
+static std::string WriteMembers( FILE* f, const std::string& arrayName, const std::vector<Member>& members )
+{
+	if ( members.empty() )
+	{
+		return "nullptr";
+	}
+	fprintf( f, "static const ManifestMember %s[] =\n{\n", arrayName.c_str() );
+	for ( auto& m : members )
+	{
+		fprintf( f, "\t{ \"%s\", 0x%08xu },\n", m.name.c_str(), m.hash );
+	}
+	fprintf( f, "};\n\n" );
+	return arrayName;
+}
+
+int main( int argc, char** argv )
+{
+	if ( argc < 2 )
+	{
+		printf( "usage: LuaBindingManifestGen <output.cpp>\n" );
+		return 1;
+	}
+
+	FILE* f = fopen( argv[1], "w" );
+	if ( f == nullptr )
+	{
+		printf( "unable to open '%s' for writing\n", argv[1] );
+		return 1;
+	}
+
+	fprintf( f, "// generated by LuaBindingManifestGen from the rttr registrations, do not edit\n" );
+	fprintf( f, "#include \"BindingManifest.h\"\n\n" );
+
+	std::vector<Member> globalMethods;
+	for ( auto& method : rttr::type::get_global_methods() )
+	{
+		globalMethods.push_back( MakeMember( method.get_name().to_string() ) );
+	}
+	SortMembers( globalMethods );
+	std::string globalMethodsArray = WriteMembers( f, "GLOBAL_METHODS", globalMethods );
+
+	struct Class
+	{
+		Member name;
+		std::string metaTableName;
+		std::string methodsArray;
+		std::string propertiesArray;
+		size_t numMethods;
+		size_t numProperties;
+		bool deferredDestroy;
+		bool dirtyTracked;
+	};
+	std::vector<Class> classes;
+	for ( auto& classToRegister : rttr::type::get_types() )
+	{
+		if ( classToRegister.is_class() == false )
+		{
+			continue;
+		}
+
+		//rttr's get_methods & get_properties include the base classes' members, as the binding flattens them
+		std::vector<Member> methods;
+		for ( auto& method : classToRegister.get_methods() )
+		{
+			methods.push_back( MakeMember( method.get_name().to_string() ) );
+		}
+		SortMembers( methods );
+
+		std::vector<Member> properties;
+		for ( auto& property : classToRegister.get_properties() )
+		{
+			properties.push_back( MakeMember( property.get_name().to_string() ) );
+		}
+		SortMembers( properties );
+
+		//class names aren't always valid identifiers (std::string...), so name the arrays by index
+		const std::string arrayPrefix = "CLASS_" + std::to_string( classes.size() );
+		Class c;
+		c.name = MakeMember( classToRegister.get_name().to_string() );
+		c.metaTableName = MetaTableName( classToRegister );
+		c.methodsArray = WriteMembers( f, arrayPrefix + "_METHODS", methods );
+		c.propertiesArray = WriteMembers( f, arrayPrefix + "_PROPERTIES", properties );
+		c.numMethods = methods.size();
+		c.numProperties = properties.size();
+		c.deferredDestroy = HasDeferredDestruction( classToRegister );
+		c.dirtyTracked = HasDirtyTracking( classToRegister );
+		classes.push_back( c );
+	}
+	std::sort( classes.begin(), classes.end(), []( const Class& a, const Class& b )
+	{
+		return a.name.hash != b.name.hash ? a.name.hash < b.name.hash : a.name.name < b.name.name;
+	} );
+
+	std::string classesArray = "nullptr";
+	if ( classes.empty() == false )
+	{
+		classesArray = "CLASSES";
+		fprintf( f, "static const ManifestClass CLASSES[] =\n{\n" );
+		for ( auto& c : classes )
+		{
+			fprintf( f, "\t{ \"%s\", \"%s\", 0x%08xu, %s, %d, %s, %d, %s, %s },\n",
+				c.name.name.c_str(), c.metaTableName.c_str(), c.name.hash,
+				c.methodsArray.c_str(), (int)c.numMethods,
+				c.propertiesArray.c_str(), (int)c.numProperties,
+				c.deferredDestroy ? "true" : "false",
+				c.dirtyTracked ? "true" : "false" );
+		}
+		fprintf( f, "};\n\n" );
+	}
+
+	fprintf( f, "static const BindingManifest MANIFEST = { %s, %d, %s, %d };\n\n",
+		globalMethodsArray.c_str(), (int)globalMethods.size(), classesArray.c_str(), (int)classes.size() );
+	fprintf( f, "const BindingManifest* GetBindingManifest()\n{\n\treturn &MANIFEST;\n}\n" );
+
+	fclose( f );
+	printf( "binding manifest: %d global methods, %d classes\n", (int)globalMethods.size(), (int)classes.size() );
+	return 0;
+}
@@ -0,0 +1,9 @@
+#include "BindingManifest.h"
+
+// Linked into LuaBindingManifestGen, which has to walk the reflection database itself
+// because it is the thing that makes the manifest.
+
+const BindingManifest* GetBindingManifest()
+{
+	return nullptr;
+}
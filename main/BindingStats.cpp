@@ -0,0 +1,293 @@
+#include "BindingStats.h"
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+
+std::atomic<bool> g_bindingStatsEnabled( false );
+
+/*! \brief One method's counters on one thread, only the owning thread writes to it */
+struct MethodCounters
+{
+	std::atomic<bool> m_isUsed;				//set once the key & names below are filled in
+	const char* m_nameKey;					//rttr's storage for the method name, the same for every copy of a method
+	size_t m_typeId;
+	rttr::string_view m_methodName;
+	rttr::string_view m_typeName;
+	std::atomic<uint64_t> m_numCalls;
+	std::atomic<uint64_t> m_marshalNs;
+	std::atomic<uint64_t> m_pushNs;
+	LatencyHistogram m_executeTimes;		//has the execute count & total too
+};
+
+/*! \brief A thread's table of counters, open addressing by method */
+struct ThreadBindingStats
+{
+	static constexpr int NUM_SLOTS = 256;
+	MethodCounters m_slots[NUM_SLOTS];
+	std::atomic<uint64_t> m_numDropped;		//calls to methods that didn't fit in the table
+
+	ThreadBindingStats()
+	{
+		for ( auto& slot : m_slots )
+		{
+			slot.m_isUsed.store( false, std::memory_order_relaxed );
+			slot.m_numCalls.store( 0, std::memory_order_relaxed );
+			slot.m_marshalNs.store( 0, std::memory_order_relaxed );
+			slot.m_pushNs.store( 0, std::memory_order_relaxed );
+		}
+		m_numDropped.store( 0, std::memory_order_relaxed );
+	}
+};
+
+//every thread's table, never freed so they can still be read after the thread exits
+static std::mutex s_allThreadStatsMutex;
+static std::vector<std::unique_ptr<ThreadBindingStats>> s_allThreadStats;
+
+static std::mutex s_scriptRunsMutex;
+static std::map<std::string, ScriptRunStats> s_scriptRuns;
+
+static ThreadBindingStats& ThisThreadStats()
+{
+	thread_local ThreadBindingStats* stats = nullptr;
+	if ( stats == nullptr )
+	{
+		std::lock_guard<std::mutex> lock( s_allThreadStatsMutex );
+		s_allThreadStats.emplace_back( new ThreadBindingStats() );
+		stats = s_allThreadStats.back().get();
+	}
+	return *stats;
+}
+
+static void Add( std::atomic<uint64_t>& counter, uint64_t value )
+{
+	counter.store( counter.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+}
+
+static MethodCounters* FindCounters( ThreadBindingStats& stats, const rttr::method& m )
+{
+	rttr::string_view name = m.get_name();
+	rttr::type declaringType = m.get_declaring_type();
+	size_t typeId = declaringType.is_valid() ? declaringType.get_id() : 0;
+
+	size_t hash = ( (uintptr_t)name.data() >> 3 ) ^ ( typeId * 0x9E3779B1u );
+	for ( int probe = 0; probe < ThreadBindingStats::NUM_SLOTS; probe++ )
+	{
+		MethodCounters& slot = stats.m_slots[( hash + probe ) & ( ThreadBindingStats::NUM_SLOTS - 1 )];
+		if ( slot.m_isUsed.load( std::memory_order_relaxed ) == false )
+		{
+			slot.m_nameKey = name.data();
+			slot.m_typeId = typeId;
+			slot.m_methodName = name;
+			slot.m_typeName = declaringType.is_valid() ? declaringType.get_name() : rttr::string_view();
+			slot.m_isUsed.store( true, std::memory_order_release );		//publish the names to readers
+			return &slot;
+		}
+		if ( slot.m_nameKey == name.data() && slot.m_typeId == typeId )
+		{
+			return &slot;
+		}
+	}
+	return nullptr;
+}
+
+uint64_t BindingStatsNow()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+void RecordBindingCall( const rttr::method& m, uint64_t marshalStart, uint64_t executeStart, uint64_t pushStart, uint64_t end )
+{
+	ThreadBindingStats& stats = ThisThreadStats();
+	MethodCounters* counters = FindCounters( stats, m );
+	if ( counters == nullptr )
+	{
+		Add( stats.m_numDropped, 1 );
+		return;
+	}
+	Add( counters->m_numCalls, 1 );
+	Add( counters->m_marshalNs, executeStart - marshalStart );
+	counters->m_executeTimes.Record( pushStart - executeStart );
+	Add( counters->m_pushNs, end - pushStart );
+}
+
+std::vector<BindingCallStats> GetBindingStats()
+{
+	struct Totals
+	{
+		uint64_t numCalls = 0;
+		uint64_t marshalNs = 0;
+		uint64_t pushNs = 0;
+		LatencyHistogram executeTimes;
+	};
+	std::map<std::string, std::unique_ptr<Totals>> totalsByName;
+	{
+		std::lock_guard<std::mutex> lock( s_allThreadStatsMutex );
+		for ( auto& threadStats : s_allThreadStats )
+		{
+			for ( auto& slot : threadStats->m_slots )
+			{
+				if ( slot.m_isUsed.load( std::memory_order_acquire ) == false )
+				{
+					continue;
+				}
+				std::string name = slot.m_typeName.to_string();
+				if ( name.empty() == false )
+				{
+					name += '.';
+				}
+				name += slot.m_methodName.to_string();
+
+				std::unique_ptr<Totals>& totals = totalsByName[name];
+				if ( totals == nullptr )
+				{
+					totals.reset( new Totals() );
+				}
+				totals->numCalls += slot.m_numCalls.load( std::memory_order_relaxed );
+				totals->marshalNs += slot.m_marshalNs.load( std::memory_order_relaxed );
+				totals->pushNs += slot.m_pushNs.load( std::memory_order_relaxed );
+				totals->executeTimes.Merge( slot.m_executeTimes );
+			}
+		}
+	}
+
+	std::vector<BindingCallStats> allStats;
+	for ( auto& entry : totalsByName )
+	{
+		const Totals& totals = *entry.second;
+		BindingCallStats stats;
+		stats.name = entry.first;
+		stats.numCalls = totals.numCalls;
+		stats.marshalNs = totals.marshalNs;
+		stats.executeNs = totals.executeTimes.TotalNs();
+		stats.pushNs = totals.pushNs;
+		stats.executeP50Ns = totals.executeTimes.PercentileNs( 50 );
+		stats.executeP99Ns = totals.executeTimes.PercentileNs( 99 );
+		stats.executeMaxNs = totals.executeTimes.MaxNs();
+		allStats.push_back( stats );
+	}
+	std::sort( allStats.begin(), allStats.end(), []( const BindingCallStats& a, const BindingCallStats& b )
+	{
+		return a.marshalNs + a.executeNs + a.pushNs > b.marshalNs + b.executeNs + b.pushNs;
+	} );
+	return allStats;
+}
+
+void RecordScriptRun( const char* name, const PerfSample& counts )
+{
+	std::lock_guard<std::mutex> lock( s_scriptRunsMutex );
+	ScriptRunStats& stats = s_scriptRuns[name];
+	if ( stats.numRuns++ == 0 )
+	{
+		stats.name = name;
+		stats.total.hasHardwareCounters = true;
+	}
+	stats.total.wallNs += counts.wallNs;
+	stats.total.cycles += counts.cycles;
+	stats.total.instructions += counts.instructions;
+	stats.total.cacheMisses += counts.cacheMisses;
+	stats.total.branchMisses += counts.branchMisses;
+	stats.total.hasHardwareCounters = stats.total.hasHardwareCounters && counts.hasHardwareCounters;
+}
+
+std::vector<ScriptRunStats> GetScriptRunStats()
+{
+	std::vector<ScriptRunStats> allStats;
+	{
+		std::lock_guard<std::mutex> lock( s_scriptRunsMutex );
+		for ( auto& entry : s_scriptRuns )
+		{
+			allStats.push_back( entry.second );
+		}
+	}
+	std::sort( allStats.begin(), allStats.end(), []( const ScriptRunStats& a, const ScriptRunStats& b )
+	{
+		return a.total.wallNs > b.total.wallNs;
+	} );
+	return allStats;
+}
+
+void PrintBindingStats()
+{
+	printf( "%-24s %10s %12s %12s %12s %10s\n", "binding", "calls", "marshal(us)", "execute(us)", "push(us)", "p99(us)" );
+	for ( const BindingCallStats& stats : GetBindingStats() )
+	{
+		printf( "%-24s %10llu %12.1f %12.1f %12.1f %10.2f\n", stats.name.c_str(),
+			(unsigned long long)stats.numCalls,
+			stats.marshalNs / 1000.0, stats.executeNs / 1000.0, stats.pushNs / 1000.0,
+			stats.executeP99Ns / 1000.0 );
+	}
+
+	std::vector<ScriptRunStats> scriptRuns = GetScriptRunStats();
+	if ( scriptRuns.empty() )
+	{
+		return;
+	}
+	printf( "%-24s %10s %12s %14s %14s %12s %12s %6s\n", "script run", "runs", "wall(us)", "cycles", "instructions", "cache miss", "branch miss", "IPC" );
+	for ( const ScriptRunStats& stats : scriptRuns )
+	{
+		if ( stats.total.hasHardwareCounters )
+		{
+			printf( "%-24s %10llu %12.1f %14llu %14llu %12llu %12llu %6.2f\n", stats.name.c_str(),
+				(unsigned long long)stats.numRuns, stats.total.wallNs / 1000.0,
+				(unsigned long long)stats.total.cycles, (unsigned long long)stats.total.instructions,
+				(unsigned long long)stats.total.cacheMisses, (unsigned long long)stats.total.branchMisses,
+				stats.total.cycles ? (double)stats.total.instructions / stats.total.cycles : 0.0 );
+		}
+		else
+		{
+			printf( "%-24s %10llu %12.1f %14s %14s %12s %12s %6s\n", stats.name.c_str(),
+				(unsigned long long)stats.numRuns, stats.total.wallNs / 1000.0, "-", "-", "-", "-", "-" );
+		}
+	}
+}
+
+int PushBindingStats( lua_State* L )
+{
+	std::vector<BindingCallStats> allStats = GetBindingStats();
+	lua_createtable( L, 0, (int)allStats.size() );
+	for ( const BindingCallStats& stats : allStats )
+	{
+		lua_createtable( L, 0, 5 );
+		lua_pushinteger( L, (lua_Integer)stats.numCalls );
+		lua_setfield( L, -2, "calls" );
+		lua_pushinteger( L, (lua_Integer)stats.marshalNs );
+		lua_setfield( L, -2, "marshalNs" );
+		lua_pushinteger( L, (lua_Integer)stats.executeNs );
+		lua_setfield( L, -2, "executeNs" );
+		lua_pushinteger( L, (lua_Integer)stats.pushNs );
+		lua_setfield( L, -2, "pushNs" );
+		lua_pushinteger( L, (lua_Integer)stats.executeP99Ns );
+		lua_setfield( L, -2, "p99Ns" );
+		lua_setfield( L, -2, stats.name.c_str() );
+	}
+
+	std::vector<ScriptRunStats> scriptRuns = GetScriptRunStats();
+	lua_createtable( L, 0, (int)scriptRuns.size() );
+	for ( const ScriptRunStats& stats : scriptRuns )
+	{
+		lua_createtable( L, 0, 6 );
+		lua_pushinteger( L, (lua_Integer)stats.numRuns );
+		lua_setfield( L, -2, "runs" );
+		lua_pushinteger( L, (lua_Integer)stats.total.wallNs );
+		lua_setfield( L, -2, "wallNs" );
+		if ( stats.total.hasHardwareCounters )
+		{
+			lua_pushinteger( L, (lua_Integer)stats.total.cycles );
+			lua_setfield( L, -2, "cycles" );
+			lua_pushinteger( L, (lua_Integer)stats.total.instructions );
+			lua_setfield( L, -2, "instructions" );
+			lua_pushinteger( L, (lua_Integer)stats.total.cacheMisses );
+			lua_setfield( L, -2, "cacheMisses" );
+			lua_pushinteger( L, (lua_Integer)stats.total.branchMisses );
+			lua_setfield( L, -2, "branchMisses" );
+		}
+		lua_setfield( L, -2, stats.name.c_str() );
+	}
+	lua_setfield( L, -2, "scriptRuns" );
+	return 1;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "lua.hpp"
+#include "PerfCounters.h"
+#include <rttr/type>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Per binding call statistics, recorded by InvokeMethod when enabled.
+// Each thread writes its own counters, so recording never takes a lock.
+
+/*! \brief The totals for one bound method, summed over every thread */
+struct BindingCallStats
+{
+	std::string name;			//"Type.Method", or just "Method" for globals
+	uint64_t numCalls;
+	uint64_t marshalNs;			//converting the Lua arguments
+	uint64_t executeNs;			//running the native function
+	uint64_t pushNs;			//putting the result on the Lua stack
+	uint64_t executeP50Ns;		//upper bounds, see LatencyHistogram::PercentileNs
+	uint64_t executeP99Ns;
+	uint64_t executeMaxNs;
+};
+
+/*! \brief The totals for one script function, or ExecuteScript, while PerfCountersEnabled() */
+struct ScriptRunStats
+{
+	std::string name;
+	uint64_t numRuns = 0;
+	PerfSample total;		//hasHardwareCounters if every run had them
+};
+
+extern std::atomic<bool> g_bindingStatsEnabled;
+
+/*! \brief Turns recording on or off, when off InvokeMethod only pays for testing this flag */
+inline void SetBindingStatsEnabled( bool enabled )
+{
+	g_bindingStatsEnabled.store( enabled, std::memory_order_relaxed );
+}
+
+inline bool BindingStatsEnabled()
+{
+	return g_bindingStatsEnabled.load( std::memory_order_relaxed );
+}
+
+/*! \return a timestamp for RecordBindingCall */
+uint64_t BindingStatsNow();
+
+/*! \brief Records a call to #m on this thread, the timestamps are from BindingStatsNow */
+void RecordBindingCall( const rttr::method& m, uint64_t marshalStart, uint64_t executeStart, uint64_t pushStart, uint64_t end );
+
+/*! \return the stats of every method called so far, the most expensive (total time) first */
+std::vector<BindingCallStats> GetBindingStats();
+
+/*! \brief Adds the #counts of one run of #name. Runs are coarse, so these are kept under a lock. */
+void RecordScriptRun( const char* name, const PerfSample& counts );
+
+/*! \return the totals of every script run recorded so far, the most expensive (wall time) first */
+std::vector<ScriptRunStats> GetScriptRunStats();
+
+/*! \brief Prints the binding stats & script run stats */
+void PrintBindingStats();
+
+/*! \brief Global.BindingStats(), returns a table of name -> { calls, marshalNs, executeNs, pushNs, p99Ns },
+*	with the script runs in its scriptRuns field, name -> { runs, wallNs, cycles, instructions, cacheMisses, branchMisses } */
+int PushBindingStats( lua_State* L );
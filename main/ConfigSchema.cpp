@@ -0,0 +1,432 @@
+#include "ConfigSchema.h"
+#include "BindingManifest.h"
+#include <cstdio>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class FieldKind
+{
+	Int,
+	Short,
+	Float,
+	Double,
+	Bool,
+	String,
+	Object,		//a registered struct, a nested table
+	Array,		//a std::vector, a sequence
+	Unsupported,
+};
+
+struct SchemaField
+{
+	std::string name;
+	uint32_t hash;			//HashName of name
+	rttr::property property;
+	FieldKind kind;
+	bool byPointer;			//registered with bind_as_ptr, get_value gives a pointer to the struct or std::vector
+};
+
+/*! \brief The fields of a type, sorted by hash, made once per type & never changed after */
+struct Schema
+{
+	std::string typeName;
+	std::vector<SchemaField> fields;
+};
+
+static const char* KindName( FieldKind kind )
+{
+	switch ( kind )
+	{
+	case FieldKind::Int: return "int";
+	case FieldKind::Short: return "short";
+	case FieldKind::Float: return "float";
+	case FieldKind::Double: return "double";
+	case FieldKind::Bool: return "bool";
+	case FieldKind::String: return "string";
+	case FieldKind::Object: return "table";
+	case FieldKind::Array: return "sequence";
+	default: return "unsupported";
+	}
+}
+
+static FieldKind KindOf( const rttr::type& t )
+{
+	if ( t == rttr::type::get<int>() )
+	{
+		return FieldKind::Int;
+	}
+	if ( t == rttr::type::get<short>() )
+	{
+		return FieldKind::Short;
+	}
+	if ( t == rttr::type::get<float>() )
+	{
+		return FieldKind::Float;
+	}
+	if ( t == rttr::type::get<double>() )
+	{
+		return FieldKind::Double;
+	}
+	if ( t == rttr::type::get<bool>() )
+	{
+		return FieldKind::Bool;
+	}
+	if ( t == rttr::type::get<std::string>() )
+	{
+		return FieldKind::String;
+	}
+	if ( t.is_sequential_container() )
+	{
+		return FieldKind::Array;
+	}
+	if ( t.is_class() && t.get_properties().empty() == false )
+	{
+		return FieldKind::Object;
+	}
+	return FieldKind::Unsupported;
+}
+
+/*! \return the schema of #t, made the first time it is asked for (from any thread) */
+static const Schema& GetSchema( const rttr::type& t )
+{
+	static std::mutex s_schemasMutex;
+	static std::unordered_map<size_t, std::unique_ptr<Schema>> s_schemas;
+
+	std::lock_guard<std::mutex> lock( s_schemasMutex );
+	std::unique_ptr<Schema>& schema = s_schemas[(size_t)t.get_id()];
+	if ( schema )
+	{
+		return *schema;
+	}
+
+	schema.reset( new Schema );
+	rttr::string_view typeName = t.get_name();
+	schema->typeName.assign( typeName.data(), typeName.size() );
+	std::vector<SchemaField> fields;
+	for ( const rttr::property& p : t.get_properties() )
+	{
+		rttr::string_view name = p.get_name();
+		FieldKind kind = KindOf( p.get_type() );
+		bool byPointer = false;
+		if ( kind == FieldKind::Unsupported && p.get_type().is_pointer() )
+		{
+			FieldKind pointeeKind = KindOf( p.get_type().get_raw_type() );
+			if ( pointeeKind == FieldKind::Object || pointeeKind == FieldKind::Array )
+			{
+				kind = pointeeKind;
+				byPointer = true;
+			}
+		}
+		if ( kind == FieldKind::Unsupported || p.is_readonly() || p.is_static() )
+		{
+			printf( "ConfigSchema - %s.%.*s can't be set from a config, skipped\n", schema->typeName.c_str(), (int)name.size(), name.data() );
+			continue;
+		}
+		fields.push_back( { std::string( name.data(), name.size() ), HashName( name.data(), name.size() ), p, kind, byPointer } );
+	}
+
+	//sorted by copying in hash order, rttr::property isn't assignable
+	std::vector<size_t> order( fields.size() );
+	for ( size_t i = 0; i < order.size(); i++ )
+	{
+		order[i] = i;
+	}
+	std::sort( order.begin(), order.end(), [&]( size_t a, size_t b )
+	{
+		return fields[a].hash < fields[b].hash;
+	} );
+	schema->fields.reserve( fields.size() );
+	for ( size_t i : order )
+	{
+		schema->fields.push_back( fields[i] );
+	}
+	return *schema;
+}
+
+static const SchemaField* FindField( const Schema& schema, const char* name, size_t length )
+{
+	uint32_t hash = HashName( name, length );
+	auto it = std::lower_bound( schema.fields.begin(), schema.fields.end(), hash, []( const SchemaField& field, uint32_t h )
+	{
+		return field.hash < h;
+	} );
+	for ( ; it != schema.fields.end() && it->hash == hash; ++it )
+	{
+		if ( it->name.size() == length && memcmp( it->name.data(), name, length ) == 0 )
+		{
+			return &*it;
+		}
+	}
+	return nullptr;
+}
+
+/*! \return the Lua value at #idx as a #kind, or an invalid variant if it isn't one */
+static rttr::variant ToScalar( lua_State* L, int idx, FieldKind kind )
+{
+	int luaType = lua_type( L, idx );
+	switch ( kind )
+	{
+	case FieldKind::Int:
+	case FieldKind::Short:
+	{
+		int isInteger = 0;
+		lua_Integer i = luaType == LUA_TNUMBER ? lua_tointegerx( L, idx, &isInteger ) : 0;
+		if ( isInteger == 0 )
+		{
+			break;
+		}
+		return kind == FieldKind::Int ? rttr::variant( (int)i ) : rttr::variant( (short)i );
+	}
+	case FieldKind::Float:
+		if ( luaType == LUA_TNUMBER )
+		{
+			return rttr::variant( (float)lua_tonumber( L, idx ) );
+		}
+		break;
+	case FieldKind::Double:
+		if ( luaType == LUA_TNUMBER )
+		{
+			return rttr::variant( (double)lua_tonumber( L, idx ) );
+		}
+		break;
+	case FieldKind::Bool:
+		if ( luaType == LUA_TBOOLEAN )
+		{
+			return rttr::variant( lua_toboolean( L, idx ) != 0 );
+		}
+		break;
+	case FieldKind::String:
+		if ( luaType == LUA_TSTRING )
+		{
+			size_t length;
+			const char* s = lua_tolstring( L, idx, &length );
+			return rttr::variant( std::string( s, length ) );
+		}
+		break;
+	default:
+		break;
+	}
+	return rttr::variant();
+}
+
+static bool FillObject( lua_State* L, int tableIdx, rttr::instance object );
+
+/*! \brief Sizes the std::vector in #array to the sequence at #tableIdx & sets each element from it */
+static bool FillArray( lua_State* L, int tableIdx, rttr::variant& array, const char* fieldName )
+{
+	rttr::variant_sequential_view view = array.create_sequential_view();
+	FieldKind elementKind = KindOf( view.get_value_type() );
+	size_t length = lua_rawlen( L, tableIdx );
+	bool ok = true;
+	if ( view.is_dynamic() )
+	{
+		view.set_size( length );
+	}
+	else if ( length > view.get_size() )
+	{
+		printf( "TableToObject - '%s' has %d elements, only room for %d\n", fieldName, (int)length, (int)view.get_size() );
+		length = view.get_size();
+		ok = false;
+	}
+
+	for ( size_t i = 0; i < length; i++ )
+	{
+		lua_rawgeti( L, tableIdx, (lua_Integer)i + 1 );
+		int valueIdx = lua_gettop( L );
+		int luaType = lua_type( L, valueIdx );
+		if ( elementKind == FieldKind::Object && luaType == LUA_TTABLE )
+		{
+			//the element is a reference in to the vector, filled where it is
+			rttr::variant element = view.get_value( i );
+			ok = FillObject( L, valueIdx, rttr::instance( element ).get_wrapped_instance() ) && ok;
+		}
+		else if ( elementKind == FieldKind::Array && luaType == LUA_TTABLE )
+		{
+			rttr::variant element = view.get_value( i ).extract_wrapped_value();
+			ok = FillArray( L, valueIdx, element, fieldName ) && ok;
+			view.set_value( i, element );
+		}
+		else
+		{
+			rttr::variant value = ToScalar( L, valueIdx, elementKind );
+			if ( value.is_valid() )
+			{
+				view.set_value( i, value );
+			}
+			else
+			{
+				printf( "TableToObject - '%s'[%d] should be a %s, not a %s\n", fieldName, (int)i + 1, KindName( elementKind ), lua_typename( L, luaType ) );
+				ok = false;
+			}
+		}
+		lua_pop( L, 1 );
+	}
+	return ok;
+}
+
+/*! \brief Sets #field of #object from the value at #valueIdx.
+*	A struct or std::vector field is filled through the pointer when it's bound with bind_as_ptr, otherwise
+*	rttr only hands out a copy, which is filled & then copied back. */
+static bool SetField( lua_State* L, int valueIdx, rttr::instance& object, const Schema& schema, const SchemaField& field )
+{
+	int luaType = lua_type( L, valueIdx );
+	if ( field.kind == FieldKind::Object && luaType == LUA_TTABLE )
+	{
+		rttr::variant nested = field.property.get_value( object );
+		bool ok = FillObject( L, valueIdx, nested );
+		if ( field.byPointer == false )
+		{
+			field.property.set_value( object, nested );
+		}
+		return ok;
+	}
+	if ( field.kind == FieldKind::Array && luaType == LUA_TTABLE )
+	{
+		rttr::variant array = field.property.get_value( object );
+		bool ok = FillArray( L, valueIdx, array, field.name.c_str() );
+		if ( field.byPointer == false )
+		{
+			field.property.set_value( object, array );
+		}
+		return ok;
+	}
+	rttr::variant value = ToScalar( L, valueIdx, field.kind );
+	if ( value.is_valid() )
+	{
+		field.property.set_value( object, value );
+		return true;
+	}
+	printf( "TableToObject - %s.%s should be a %s, not a %s\n", schema.typeName.c_str(), field.name.c_str(), KindName( field.kind ), lua_typename( L, luaType ) );
+	return false;
+}
+
+static bool FillObject( lua_State* L, int tableIdx, rttr::instance object )
+{
+	if ( object.is_valid() == false )
+	{
+		return false;
+	}
+	if ( lua_checkstack( L, 4 ) == 0 )
+	{
+		printf( "TableToObject - the config is nested too deep\n" );
+		return false;
+	}
+	const Schema& schema = GetSchema( object.get_type().get_raw_type() );
+	bool ok = true;
+	lua_pushnil( L );
+	while ( lua_next( L, tableIdx ) != 0 )
+	{
+		//key at -2, value at -1
+		int valueIdx = lua_gettop( L );
+		if ( lua_type( L, -2 ) != LUA_TSTRING )
+		{
+			printf( "TableToObject - %s only has named fields, found a %s key\n", schema.typeName.c_str(), luaL_typename( L, -2 ) );
+			ok = false;
+		}
+		else
+		{
+			size_t length;
+			const char* key = lua_tolstring( L, -2, &length );
+			const SchemaField* field = FindField( schema, key, length );
+			if ( field )
+			{
+				ok = SetField( L, valueIdx, object, schema, *field ) && ok;
+			}
+			else
+			{
+				printf( "TableToObject - %s has no field '%s'\n", schema.typeName.c_str(), key );
+				ok = false;
+			}
+		}
+		lua_pop( L, 1 );
+	}
+	return ok;
+}
+
+bool TableToObject( lua_State* L, int tableIdx, rttr::instance object )
+{
+	tableIdx = lua_absindex( L, tableIdx );
+	if ( lua_type( L, tableIdx ) != LUA_TTABLE )
+	{
+		printf( "TableToObject - expected a table, got a %s\n", luaL_typename( L, tableIdx ) );
+		return false;
+	}
+	return FillObject( L, tableIdx, object );
+}
+
+static void PushValue( lua_State* L, const rttr::variant& value, FieldKind kind );
+
+static void PushArray( lua_State* L, const rttr::variant& array )
+{
+	rttr::variant_sequential_view view = array.create_sequential_view();
+	FieldKind elementKind = KindOf( view.get_value_type() );
+	size_t length = view.get_size();
+	lua_createtable( L, (int)length, 0 );
+	for ( size_t i = 0; i < length; i++ )
+	{
+		rttr::variant element = view.get_value( i );
+		if ( elementKind == FieldKind::Object )
+		{
+			PushObjectAsTable( L, rttr::instance( element ).get_wrapped_instance() );
+		}
+		else
+		{
+			PushValue( L, element.extract_wrapped_value(), elementKind );
+		}
+		lua_rawseti( L, -2, (lua_Integer)i + 1 );
+	}
+}
+
+static void PushValue( lua_State* L, const rttr::variant& value, FieldKind kind )
+{
+	switch ( kind )
+	{
+	case FieldKind::Int:
+		lua_pushinteger( L, value.get_value<int>() );
+		break;
+	case FieldKind::Short:
+		lua_pushinteger( L, value.get_value<short>() );
+		break;
+	case FieldKind::Float:
+		lua_pushnumber( L, value.get_value<float>() );
+		break;
+	case FieldKind::Double:
+		lua_pushnumber( L, value.get_value<double>() );
+		break;
+	case FieldKind::Bool:
+		lua_pushboolean( L, value.get_value<bool>() );
+		break;
+	case FieldKind::String:
+	{
+		const std::string& s = value.get_value<std::string>();
+		lua_pushlstring( L, s.data(), s.size() );
+		break;
+	}
+	case FieldKind::Object:
+		PushObjectAsTable( L, value );
+		break;
+	case FieldKind::Array:
+		PushArray( L, value );
+		break;
+	default:
+		lua_pushnil( L );
+		break;
+	}
+}
+
+void PushObjectAsTable( lua_State* L, rttr::instance object )
+{
+	luaL_checkstack( L, 3, "PushObjectAsTable - the object is nested too deep" );
+	const Schema& schema = GetSchema( object.get_type().get_raw_type() );
+	lua_createtable( L, 0, (int)schema.fields.size() );
+	for ( const SchemaField& field : schema.fields )
+	{
+		PushValue( L, field.property.get_value( object ), field.kind );
+		lua_setfield( L, -2, field.name.c_str() );
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "lua.hpp"
+#include <rttr/type>
+
+/*! \brief Copies a Lua config table in to an rttr registered struct, and back out again.
+*	The fields are the struct's registered properties: int, short, float, double, bool, std::string,
+*	other registered structs (a nested table) & std::vector's of any of these (a sequence), e.g.
+*		Level = { name = "Caves", player = { x = 16, y = 32 }, spawns = { { x = 1, y = 2 }, { x = 3, y = 4 } } }
+*		LevelConfig level;
+*		lua_getglobal( L, "Level" );
+*		TableToObject( L, -1, level );
+*	The table is walked once with lua_next, each key found in a table of the type's fields that is made
+*	the first time the type is seen, rather than a lua_getfield per field.
+*	Nested structs & std::vector's are filled in place when their property is bound as a pointer, e.g.
+*		.property("spawns", &LevelConfig::spawns)( rttr::policy::prop::bind_as_ptr )
+*	otherwise rttr's get_value is a copy, so the field is copied out, filled & copied back. */
+
+/*! \brief Sets the fields of #object from the table at #tableIdx, leaving fields not in the table as they are.
+*	\return false if the table had a key that isn't a field or a value of the wrong type (printed), the rest are still set */
+bool TableToObject( lua_State* L, int tableIdx, rttr::instance object );
+
+/*! \brief Pushes a new table with a key for each field of #object, sized up front with lua_createtable */
+void PushObjectAsTable( lua_State* L, rttr::instance object );
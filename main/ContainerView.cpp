@@ -0,0 +1,514 @@
+#include "ContainerView.h"
+#include "AutomatedBinding.h"
+#include <cstdio>
+#include <new>
+#include <string>
+#include <vector>
+
+enum class ElementKind
+{
+	Int,
+	Short,
+	Float,
+	Double,
+	Bool,
+	String,
+	Other,		//a class, sent to & from Lua by the binding
+};
+
+static ElementKind KindOf( const rttr::type& t )
+{
+	if ( t == rttr::type::get<int>() )
+	{
+		return ElementKind::Int;
+	}
+	if ( t == rttr::type::get<short>() )
+	{
+		return ElementKind::Short;
+	}
+	if ( t == rttr::type::get<float>() )
+	{
+		return ElementKind::Float;
+	}
+	if ( t == rttr::type::get<double>() )
+	{
+		return ElementKind::Double;
+	}
+	if ( t == rttr::type::get<bool>() )
+	{
+		return ElementKind::Bool;
+	}
+	if ( t == rttr::type::get<std::string>() )
+	{
+		return ElementKind::String;
+	}
+	return ElementKind::Other;
+}
+
+/*! \brief The userdata of a view, the rttr view points at the container in (or pointed to by) m_container */
+struct ContainerView
+{
+	rttr::variant m_container;
+	rttr::variant_sequential_view m_sequence;	//valid for a sequential container
+	rttr::variant_associative_view m_map;		//valid for an associative container
+	ElementKind m_keyKind;
+	ElementKind m_valueKind;
+	bool m_readOnly;
+
+	//the typed fast path, set for a std::vector of numbers
+	void* m_native;
+	size_t (*m_nativeSize)( void* native );
+	void (*m_nativePush)( lua_State* L, void* native, size_t i );
+	void (*m_nativeSet)( lua_State* L, void* native, size_t i, int valueIdx );		//i == size appends
+};
+
+static void PushNumber( lua_State* L, int value ) { lua_pushinteger( L, value ); }
+static void PushNumber( lua_State* L, short value ) { lua_pushinteger( L, value ); }
+static void PushNumber( lua_State* L, float value ) { lua_pushnumber( L, value ); }
+static void PushNumber( lua_State* L, double value ) { lua_pushnumber( L, value ); }
+
+static void CheckNumber( lua_State* L, int idx, int& value ) { value = (int)luaL_checkinteger( L, idx ); }
+static void CheckNumber( lua_State* L, int idx, short& value ) { value = (short)luaL_checkinteger( L, idx ); }
+static void CheckNumber( lua_State* L, int idx, float& value ) { value = (float)luaL_checknumber( L, idx ); }
+static void CheckNumber( lua_State* L, int idx, double& value ) { value = (double)luaL_checknumber( L, idx ); }
+
+template< typename T >
+struct TypedVector
+{
+	static size_t Size( void* native )
+	{
+		return ( (std::vector<T>*)native )->size();
+	}
+
+	static void Push( lua_State* L, void* native, size_t i )
+	{
+		PushNumber( L, ( *(std::vector<T>*)native )[i] );
+	}
+
+	static void Set( lua_State* L, void* native, size_t i, int valueIdx )
+	{
+		std::vector<T>& v = *(std::vector<T>*)native;
+		T value;
+		CheckNumber( L, valueIdx, value );	//can error, before the vector is touched
+		if ( i == v.size() )
+		{
+			v.push_back( value );
+		}
+		else
+		{
+			v[i] = value;
+		}
+	}
+
+	/*! \return true if #view is a std::vector<T>, and it now uses the fast path */
+	static bool Use( ContainerView& view )
+	{
+		std::vector<T>* native = nullptr;
+		if ( view.m_container.is_type<std::vector<T>*>() )
+		{
+			native = view.m_container.get_value<std::vector<T>*>();
+		}
+		else if ( view.m_container.is_type<std::vector<T>>() )
+		{
+			native = &view.m_container.get_value<std::vector<T>>();
+		}
+		if ( native == nullptr )
+		{
+			return false;
+		}
+		view.m_native = native;
+		view.m_nativeSize = Size;
+		view.m_nativePush = Push;
+		view.m_nativeSet = Set;
+		return true;
+	}
+};
+
+static void UseTypedVector( ContainerView& view )
+{
+	if ( TypedVector<int>::Use( view ) || TypedVector<float>::Use( view ) )
+	{
+		return;
+	}
+	if ( TypedVector<double>::Use( view ) || TypedVector<short>::Use( view ) )
+	{
+		return;
+	}
+}
+
+/*! \brief Pushes #element, a value or a std::reference_wrapper to one as the views give them */
+static void PushElement( lua_State* L, const rttr::variant& element, ElementKind kind )
+{
+	rttr::variant value = element.get_type().is_wrapper() ? element.extract_wrapped_value() : element;
+	switch ( kind )
+	{
+	case ElementKind::Int:
+		lua_pushinteger( L, value.get_value<int>() );
+		break;
+	case ElementKind::Short:
+		lua_pushinteger( L, value.get_value<short>() );
+		break;
+	case ElementKind::Float:
+		lua_pushnumber( L, value.get_value<float>() );
+		break;
+	case ElementKind::Double:
+		lua_pushnumber( L, value.get_value<double>() );
+		break;
+	case ElementKind::Bool:
+		lua_pushboolean( L, value.get_value<bool>() );
+		break;
+	case ElementKind::String:
+	{
+		const std::string& str = value.get_value<std::string>();
+		lua_pushlstring( L, str.data(), str.size() );
+		break;
+	}
+	default:
+		ToLua( L, value );
+		break;
+	}
+}
+
+/*! \return the Lua value at #idx as a #t, or an invalid variant if it can't be one */
+static rttr::variant ToElement( lua_State* L, int idx, ElementKind kind, const rttr::type& t )
+{
+	int luaType = lua_type( L, idx );
+	switch ( kind )
+	{
+	case ElementKind::Int:
+	case ElementKind::Short:
+	{
+		int isInteger = 0;
+		lua_Integer i = luaType == LUA_TNUMBER ? lua_tointegerx( L, idx, &isInteger ) : 0;
+		if ( isInteger )
+		{
+			return kind == ElementKind::Int ? rttr::variant( (int)i ) : rttr::variant( (short)i );
+		}
+		break;
+	}
+	case ElementKind::Float:
+	case ElementKind::Double:
+		if ( luaType == LUA_TNUMBER )
+		{
+			return kind == ElementKind::Float ? rttr::variant( (float)lua_tonumber( L, idx ) ) : rttr::variant( (double)lua_tonumber( L, idx ) );
+		}
+		break;
+	case ElementKind::Bool:
+		if ( luaType == LUA_TBOOLEAN )
+		{
+			return rttr::variant( lua_toboolean( L, idx ) != 0 );
+		}
+		break;
+	case ElementKind::String:
+		if ( luaType == LUA_TSTRING )
+		{
+			size_t length = 0;
+			const char* str = lua_tolstring( L, idx, &length );
+			return rttr::variant( std::string( str, length ) );
+		}
+		break;
+	default:
+		if ( UserDatum* ud = ToUserDatum( L, idx, t ) )
+		{
+			return ud->m_object;
+		}
+		break;
+	}
+	return rttr::variant();
+}
+
+static size_t SequenceSize( const ContainerView& view )
+{
+	return view.m_native ? view.m_nativeSize( view.m_native ) : view.m_sequence.get_size();
+}
+
+static void PushSequenceElement( lua_State* L, const ContainerView& view, size_t i )
+{
+	if ( view.m_native )
+	{
+		view.m_nativePush( L, view.m_native, i );
+	}
+	else
+	{
+		PushElement( L, view.m_sequence.get_value( i ), view.m_valueKind );
+	}
+}
+
+static void CheckWritable( lua_State* L, const ContainerView& view )
+{
+	if ( view.m_readOnly )
+	{
+		luaL_error( L, "This container is a copy, register its property with rttr::policy::prop::bind_as_ptr to change it" );
+	}
+}
+
+static int IndexSequence( lua_State* L )
+{
+	const ContainerView& view = *(ContainerView*)lua_touserdata( L, 1 );
+	int isInteger = 0;
+	lua_Integer i = lua_tointegerx( L, 2, &isInteger );
+	if ( isInteger == 0 || i < 1 || (lua_Unsigned)i > SequenceSize( view ) )
+	{
+		lua_pushnil( L );
+		return 1;
+	}
+	PushSequenceElement( L, view, (size_t)i - 1 );
+	return 1;
+}
+
+static int NewIndexSequence( lua_State* L )
+{
+	ContainerView& view = *(ContainerView*)lua_touserdata( L, 1 );
+	CheckWritable( L, view );
+	int isInteger = 0;
+	lua_Integer i = lua_tointegerx( L, 2, &isInteger );
+	size_t size = SequenceSize( view );
+	if ( isInteger == 0 || i < 1 || (lua_Unsigned)i > size + 1 )
+	{
+		luaL_error( L, "Cannot set element '%s' of a sequence of %d elements", luaL_tolstring( L, 2, nullptr ), (int)size );
+	}
+
+	if ( view.m_native )
+	{
+		view.m_nativeSet( L, view.m_native, (size_t)i - 1, 3 );
+		return 0;
+	}
+
+	bool wasSet = false;
+	{
+		//scoped, so the variant is gone before luaL_error
+		rttr::variant value = ToElement( L, 3, view.m_valueKind, view.m_sequence.get_value_type() );
+		if ( value.is_valid() )
+		{
+			wasSet = (lua_Unsigned)i <= size || ( view.m_sequence.is_dynamic() && view.m_sequence.set_size( size + 1 ) );
+			wasSet = wasSet && view.m_sequence.set_value( (size_t)i - 1, value );
+		}
+	}
+	if ( wasSet == false )
+	{
+		luaL_error( L, "Cannot set element %d of a sequence of '%s' to a %s", (int)i,
+			view.m_sequence.get_value_type().get_name().to_string().c_str(), luaL_typename( L, 3 ) );
+	}
+	return 0;
+}
+
+static int SequenceNext( lua_State* L )
+{
+	const ContainerView& view = *(ContainerView*)luaL_checkudata( L, 1, SEQUENCE_VIEW_METATABLE );
+	lua_Integer i = luaL_optinteger( L, 2, 0 );
+	if ( i < 0 || (lua_Unsigned)i >= SequenceSize( view ) )
+	{
+		lua_pushnil( L );
+		return 1;
+	}
+	lua_pushinteger( L, i + 1 );
+	PushSequenceElement( L, view, (size_t)i );
+	return 2;
+}
+
+/*! \brief __pairs & __ipairs for a sequence, both go 1 to # */
+static int SequencePairs( lua_State* L )
+{
+	lua_pushcfunction( L, SequenceNext );
+	lua_pushvalue( L, 1 );
+	lua_pushinteger( L, 0 );
+	return 3;
+}
+
+static int IndexMap( lua_State* L )
+{
+	ContainerView& view = *(ContainerView*)lua_touserdata( L, 1 );
+	bool found = false;
+	{
+		rttr::variant key = ToElement( L, 2, view.m_keyKind, view.m_map.get_key_type() );
+		if ( key.is_valid() )
+		{
+			rttr::variant_associative_view::const_iterator it = view.m_map.find( key );
+			found = it != view.m_map.end();
+			if ( found && view.m_map.is_key_only_type() )
+			{
+				lua_pushboolean( L, 1 );	//a set, the value is whether the key is in it
+			}
+			else if ( found )
+			{
+				PushElement( L, it.get_value(), view.m_valueKind );
+			}
+		}
+	}
+	if ( found == false )
+	{
+		lua_pushnil( L );
+	}
+	return 1;
+}
+
+static int NewIndexMap( lua_State* L )
+{
+	ContainerView& view = *(ContainerView*)lua_touserdata( L, 1 );
+	CheckWritable( L, view );
+	bool wasSet = false;
+	{
+		rttr::variant key = ToElement( L, 2, view.m_keyKind, view.m_map.get_key_type() );
+		if ( key.is_valid() )
+		{
+			bool remove = view.m_map.is_key_only_type() ? lua_toboolean( L, 3 ) == 0 : lua_isnil( L, 3 );
+			if ( remove )
+			{
+				view.m_map.erase( key );
+				wasSet = true;
+			}
+			else if ( view.m_map.is_key_only_type() )
+			{
+				view.m_map.insert( key );
+				wasSet = true;
+			}
+			else
+			{
+				rttr::variant value = ToElement( L, 3, view.m_valueKind, view.m_map.get_value_type() );
+				if ( value.is_valid() )
+				{
+					//the views can't assign through an iterator, so an existing key is replaced
+					view.m_map.erase( key );
+					wasSet = view.m_map.insert( key, value ).second;
+				}
+			}
+		}
+	}
+	if ( wasSet == false )
+	{
+		luaL_error( L, "Cannot set a %s key of a '%s' to a %s", luaL_typename( L, 2 ),
+			view.m_map.get_type().get_name().to_string().c_str(), luaL_typename( L, 3 ) );
+	}
+	return 0;
+}
+
+/*! \brief The key after the one at 2, found with a lookup each step so the iteration holds no state */
+static int MapNext( lua_State* L )
+{
+	ContainerView& view = *(ContainerView*)luaL_checkudata( L, 1, MAP_VIEW_METATABLE );
+	bool found = false;
+	{
+		rttr::variant_associative_view::const_iterator it = view.m_map.begin();
+		if ( lua_isnoneornil( L, 2 ) == false )
+		{
+			rttr::variant key = ToElement( L, 2, view.m_keyKind, view.m_map.get_key_type() );
+			it = key.is_valid() ? view.m_map.find( key ) : view.m_map.end();
+			if ( it != view.m_map.end() )
+			{
+				++it;
+			}
+		}
+		found = it != view.m_map.end();
+		if ( found )
+		{
+			PushElement( L, it.get_key(), view.m_keyKind );
+			if ( view.m_map.is_key_only_type() )
+			{
+				lua_pushboolean( L, 1 );
+			}
+			else
+			{
+				PushElement( L, it.get_value(), view.m_valueKind );
+			}
+		}
+	}
+	if ( found == false )
+	{
+		lua_pushnil( L );
+		return 1;
+	}
+	return 2;
+}
+
+static int MapPairs( lua_State* L )
+{
+	lua_pushcfunction( L, MapNext );
+	lua_pushvalue( L, 1 );
+	lua_pushnil( L );
+	return 3;
+}
+
+static int ViewLength( lua_State* L )
+{
+	const ContainerView& view = *(ContainerView*)lua_touserdata( L, 1 );
+	lua_pushinteger( L, (lua_Integer)( view.m_map.is_valid() ? view.m_map.get_size() : SequenceSize( view ) ) );
+	return 1;
+}
+
+static int DestroyView( lua_State* L )
+{
+	( (ContainerView*)lua_touserdata( L, 1 ) )->~ContainerView();
+	return 0;
+}
+
+/*! \brief Pushes the metatable for a sequence or map view, made the first time it is needed */
+static void PushViewMetaTable( lua_State* L, bool sequence )
+{
+	static const luaL_Reg SEQUENCE_METAMETHODS[] =
+	{
+		{ "__index", IndexSequence },
+		{ "__newindex", NewIndexSequence },
+		{ "__len", ViewLength },
+		{ "__pairs", SequencePairs },
+		{ "__ipairs", SequencePairs },
+		{ "__gc", DestroyView },
+		{ nullptr, nullptr }
+	};
+
+	static const luaL_Reg MAP_METAMETHODS[] =
+	{
+		{ "__index", IndexMap },
+		{ "__newindex", NewIndexMap },
+		{ "__len", ViewLength },
+		{ "__pairs", MapPairs },
+		{ "__gc", DestroyView },
+		{ nullptr, nullptr }
+	};
+
+	if ( luaL_newmetatable( L, sequence ? SEQUENCE_VIEW_METATABLE : MAP_VIEW_METATABLE ) )
+	{
+		luaL_setfuncs( L, sequence ? SEQUENCE_METAMETHODS : MAP_METAMETHODS, 0 );
+	}
+}
+
+bool IsViewableContainer( const rttr::variant& v )
+{
+	return v.is_sequential_container() || v.is_associative_container();
+}
+
+int PushContainerView( lua_State* L, const rttr::variant& container, int ownerIdx, bool readOnly )
+{
+	if ( ownerIdx != 0 )
+	{
+		ownerIdx = lua_absindex( L, ownerIdx );
+	}
+	ContainerView* view = new ( lua_newuserdata( L, sizeof( ContainerView ) ) ) ContainerView();
+	view->m_container = container;		//the views are made from this copy, which doesn't move
+	view->m_keyKind = ElementKind::Other;
+	view->m_valueKind = ElementKind::Other;
+	view->m_readOnly = readOnly;
+	view->m_native = nullptr;
+
+	bool sequence = view->m_container.is_sequential_container();
+	if ( sequence )
+	{
+		view->m_sequence = view->m_container.create_sequential_view();
+		view->m_valueKind = KindOf( view->m_sequence.get_value_type() );
+		UseTypedVector( *view );
+	}
+	else
+	{
+		view->m_map = view->m_container.create_associative_view();
+		view->m_keyKind = KindOf( view->m_map.get_key_type() );
+		view->m_valueKind = KindOf( view->m_map.get_value_type() );
+	}
+
+	PushViewMetaTable( L, sequence );
+	lua_setmetatable( L, -2 );
+	if ( ownerIdx != 0 )
+	{
+		lua_pushvalue( L, ownerIdx );
+		lua_setuservalue( L, -2 );	//the owner's storage is what the view points at
+	}
+	return 1;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "lua.hpp"
+#include <rttr/type>
+
+/*! \brief A std::vector (or other rttr sequential container) or std::map (or other associative container)
+*	as a userdata that reads & writes the native container, instead of copying it in to a table.
+*	From Lua:
+*		#inv.counts  inv.counts[1]  inv.counts[1] = 5  inv.counts[#inv.counts + 1] = 7	-- 1 based, appending grows it
+*		inv.prices["sword"]  inv.prices["sword"] = 12  inv.prices["sword"] = nil	-- nil removes the key
+*		for i, v in ipairs( inv.counts ) do ... end  for k, v in pairs( inv.prices ) do ... end
+*	A property is only viewed in place when it is registered bound as a pointer, e.g.
+*		.property("counts", &Inventory::counts)( rttr::policy::prop::bind_as_ptr )
+*	otherwise rttr hands back a copy, and the view of it is read only so writes aren't silently lost.
+*	A std::vector of int, short, float or double is indexed directly, without going through rttr::variant.
+*	Elements that are classes are copied to Lua, change one & assign it back to change the container. */
+
+constexpr const char* SEQUENCE_VIEW_METATABLE = "SequenceView_MT_";
+constexpr const char* MAP_VIEW_METATABLE = "MapView_MT_";
+
+/*! \return true if #v holds a container (or a pointer to one) that PushContainerView can view */
+bool IsViewableContainer( const rttr::variant& v );
+
+/*! \brief Pushes a view of the container in #container, which holds the container or a pointer to it.
+*	\param ownerIdx the userdata that owns the container, kept alive by the view, or 0 if #container holds its own copy
+*	\return the number of values pushed */
+int PushContainerView( lua_State* L, const rttr::variant& container, int ownerIdx, bool readOnly );
@@ -0,0 +1,104 @@
+#include "DeferredDestruction.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/*! \brief An object waiting to be destroyed, pushed on to a lock free stack */
+struct DeferredObject
+{
+	rttr::variant m_object;
+	DeferredObject* m_next;
+};
+
+static std::atomic<DeferredObject*> s_deferredHead( nullptr );
+static std::atomic<int> s_numDeferred( 0 );
+static std::atomic<bool> s_destructorThreadRunning( false );
+static std::thread s_destructorThread;
+
+bool HasDeferredDestruction( const rttr::type& t )
+{
+	rttr::variant deferred = t.get_metadata( DEFERRED_DESTROY );
+	if ( deferred.is_type<bool>() )
+	{
+		return deferred.get_value<bool>();
+	}
+	//not set on the class, it's inherited from its base classes like the rest of the class
+	for ( const rttr::type& base : t.get_base_classes() )
+	{
+		rttr::variant baseDeferred = base.get_metadata( DEFERRED_DESTROY );
+		if ( baseDeferred.is_type<bool>() && baseDeferred.get_value<bool>() )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void DeferDestruction( rttr::variant&& object )
+{
+	DeferredObject* deferred = new DeferredObject{ std::move( object ), nullptr };
+	deferred->m_next = s_deferredHead.load( std::memory_order_relaxed );
+	while ( s_deferredHead.compare_exchange_weak( deferred->m_next, deferred, std::memory_order_release, std::memory_order_relaxed ) == false )
+	{
+	}
+	s_numDeferred.fetch_add( 1, std::memory_order_relaxed );
+}
+
+int RunDeferredDestructors()
+{
+	//take the whole stack in one go, so there's no ABA problem with popping single nodes
+	DeferredObject* head = s_deferredHead.exchange( nullptr, std::memory_order_acquire );
+
+	//it's newest first, reverse it to destroy in the order they were collected
+	DeferredObject* ordered = nullptr;
+	while ( head )
+	{
+		DeferredObject* next = head->m_next;
+		head->m_next = ordered;
+		ordered = head;
+		head = next;
+	}
+
+	int numDestroyed = 0;
+	while ( ordered )
+	{
+		DeferredObject* next = ordered->m_next;
+		delete ordered;		//~variant() runs the native destructor
+		ordered = next;
+		numDestroyed++;
+	}
+	s_numDeferred.fetch_sub( numDestroyed, std::memory_order_relaxed );
+	return numDestroyed;
+}
+
+void StartDestructorThread( int intervalMilliseconds )
+{
+	if ( s_destructorThreadRunning.exchange( true ) )
+	{
+		return;		//already running
+	}
+	s_destructorThread = std::thread( [intervalMilliseconds]()
+	{
+		while ( s_destructorThreadRunning.load( std::memory_order_relaxed ) )
+		{
+			if ( RunDeferredDestructors() == 0 )
+			{
+				std::this_thread::sleep_for( std::chrono::milliseconds( intervalMilliseconds ) );
+			}
+		}
+		RunDeferredDestructors();
+	} );
+}
+
+void StopDestructorThread()
+{
+	if ( s_destructorThreadRunning.exchange( false ) )
+	{
+		s_destructorThread.join();
+	}
+}
+
+int NumDeferredDestructions()
+{
+	return s_numDeferred.load( std::memory_order_relaxed );
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <rttr/type>
+
+/*! \brief Class metadata to opt a type in to deferred destruction, e.g.
+*	rttr::registration::class_<Texture>("Texture")( rttr::metadata( DEFERRED_DESTROY, true ) )
+*	When Lua collects one of these its memory is freed straight away, but the native destructor is queued
+*	& run later by RunDeferredDestructors() or the destructor thread, keeping it out of the GC pause.
+*	NOTE: the destructor may then run on another thread. */
+constexpr char DEFERRED_DESTROY[] = "DeferredDestroy";		//an array, so rttr keys the metadata by std::string
+
+/*! \return true if #t was registered with DEFERRED_DESTROY, or it doesn't say & a base class was */
+bool HasDeferredDestruction( const rttr::type& t );
+
+/*! \brief Queues #object to be destroyed later, lock free & safe to call from any thread */
+void DeferDestruction( rttr::variant&& object );
+
+/*! \brief Destroys everything queued so far, in the order it was queued.
+*	\return the number of objects destroyed */
+int RunDeferredDestructors();
+
+/*! \brief Starts a background thread that runs the queued destructors every #intervalMilliseconds */
+void StartDestructorThread( int intervalMilliseconds = 1 );
+
+/*! \brief Stops the destructor thread, after it has destroyed everything still queued */
+void StopDestructorThread();
+
+/*! \brief Objects queued but not yet destroyed */
+int NumDeferredDestructions();
@@ -0,0 +1,122 @@
+#include "DirtyTracking.h"
+#include "AutomatedBinding.h"
+#include <new>
+#include <assert.h>
+
+static char DIRTY_LIST_KEY;		//registry[&DIRTY_LIST_KEY] = the state's DirtyList
+
+/*! \brief A full userdata in the registry, so it goes when the state does */
+struct DirtyList
+{
+	std::vector<UserDatum*> m_objects;
+};
+
+bool HasDirtyTracking( const rttr::type& t )
+{
+	rttr::variant tracked = t.get_metadata( DIRTY_TRACKED );
+	if ( tracked.is_type<bool>() )
+	{
+		return tracked.get_value<bool>();
+	}
+	//not set on the class, it's inherited, so an AnimatedSprite is tracked like the Sprite it derives from
+	for ( const rttr::type& base : t.get_base_classes() )
+	{
+		rttr::variant baseTracked = base.get_metadata( DIRTY_TRACKED );
+		if ( baseTracked.is_type<bool>() && baseTracked.get_value<bool>() )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool MethodMarksDirty( const rttr::method& m )
+{
+	rttr::variant marksDirty = m.get_metadata( DIRTY_TRACKED );
+	if ( marksDirty.is_type<bool>() )
+	{
+		return marksDirty.get_value<bool>();
+	}
+	return m.is_const() == false;
+}
+
+/*! \brief __gc for the DirtyList, on lua_close it can go before the objects on it */
+static int DestroyDirtyList( lua_State* L )
+{
+	DirtyList* list = (DirtyList*)lua_touserdata( L, 1 );
+	for ( UserDatum* ud : list->m_objects )
+	{
+		ud->m_dirtyIdx = NOT_DIRTY;
+	}
+	list->~DirtyList();
+
+	lua_pushnil( L );
+	lua_rawsetp( L, LUA_REGISTRYINDEX, &DIRTY_LIST_KEY );
+	return 0;
+}
+
+static DirtyList* GetDirtyList( lua_State* L, bool create )
+{
+	lua_rawgetp( L, LUA_REGISTRYINDEX, &DIRTY_LIST_KEY );
+	DirtyList* list = (DirtyList*)lua_touserdata( L, -1 );
+	lua_pop( L, 1 );
+	if ( list || create == false )
+	{
+		return list;
+	}
+
+	list = new ( lua_newuserdata( L, sizeof( DirtyList ) ) ) DirtyList();
+	lua_createtable( L, 0, 1 );
+	lua_pushcfunction( L, DestroyDirtyList );
+	lua_setfield( L, -2, "__gc" );
+	lua_setmetatable( L, -2 );
+	lua_rawsetp( L, LUA_REGISTRYINDEX, &DIRTY_LIST_KEY );
+	return list;
+}
+
+void MarkDirty( lua_State* L, UserDatum* ud )
+{
+	if ( ud->m_dirtyIdx != NOT_DIRTY )
+	{
+		return;
+	}
+	DirtyList* list = GetDirtyList( L, true );
+	ud->m_dirtyIdx = (uint32_t)list->m_objects.size();
+	list->m_objects.push_back( ud );
+}
+
+void ForgetDirty( lua_State* L, UserDatum* ud )
+{
+	if ( ud->m_dirtyIdx == NOT_DIRTY )
+	{
+		return;
+	}
+	DirtyList* list = GetDirtyList( L, false );
+	assert( list && ud->m_dirtyIdx < list->m_objects.size() && list->m_objects[ud->m_dirtyIdx] == ud );
+
+	//swap with the last, the list is in no particular order
+	UserDatum* last = list->m_objects.back();
+	list->m_objects[ud->m_dirtyIdx] = last;
+	last->m_dirtyIdx = ud->m_dirtyIdx;
+	list->m_objects.pop_back();
+	ud->m_dirtyIdx = NOT_DIRTY;
+}
+
+const std::vector<UserDatum*>& DirtyObjects( lua_State* L )
+{
+	static const std::vector<UserDatum*> none;
+	DirtyList* list = GetDirtyList( L, false );
+	return list ? list->m_objects : none;
+}
+
+void ClearDirtyObjects( lua_State* L )
+{
+	if ( DirtyList* list = GetDirtyList( L, false ) )
+	{
+		for ( UserDatum* ud : list->m_objects )
+		{
+			ud->m_dirtyIdx = NOT_DIRTY;
+		}
+		list->m_objects.clear();
+	}
+}
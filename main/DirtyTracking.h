@@ -0,0 +1,33 @@
+#pragma once
+#include "lua.hpp"
+#include <rttr/type>
+#include <vector>
+
+struct UserDatum;
+
+/*! \brief Class metadata to opt a type in to dirty tracking, e.g.
+*	rttr::registration::class_<Sprite>("Sprite")( rttr::metadata( DIRTY_TRACKED, true ) )
+*	Setting a property of one from Lua, or calling one of its non-const methods, puts it on its state's dirty list,
+*	so native code can handle just what the scripts changed. The metadata on a method overrides that, e.g. for a
+*	non-const method that doesn't change what native code cares about:
+*		.method("Prefetch", &Texture::Prefetch)( rttr::metadata( DIRTY_TRACKED, false ) ) */
+constexpr char DIRTY_TRACKED[] = "DirtyTracked";
+
+/*! \return true if #t was registered with DIRTY_TRACKED, or it doesn't say & a base class was */
+bool HasDirtyTracking( const rttr::type& t );
+
+/*! \return true if #m is non-const, unless it was registered with DIRTY_TRACKED saying otherwise */
+bool MethodMarksDirty( const rttr::method& m );
+
+/*! \brief Puts #ud on #L's dirty list, if it isn't already */
+void MarkDirty( lua_State* L, UserDatum* ud );
+
+/*! \brief Takes #ud off #L's dirty list, for when it is collected */
+void ForgetDirty( lua_State* L, UserDatum* ud );
+
+/*! \brief The userdata changed from Lua since the last ClearDirtyObjects, each one once.
+*	Valid until Lua runs again, as a collection takes the collected ones off the list. */
+const std::vector<UserDatum*>& DirtyObjects( lua_State* L );
+
+/*! \brief Empties the dirty list, call once the changes have been handled */
+void ClearDirtyObjects( lua_State* L );
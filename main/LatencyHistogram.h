@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+/*! \brief Histogram of durations, bucket i counts durations of [2^i, 2^(i+1)) nanoseconds.
+*	Only one thread may Record() into a histogram, but any thread can read it while it is being written
+*	(the counters are relaxed atomics, so recording never takes a lock or a locked instruction). */
+struct LatencyHistogram
+{
+	static constexpr int NUM_BUCKETS = 40;		//2^40ns is about 18 minutes
+
+	std::atomic<uint64_t> m_buckets[NUM_BUCKETS];
+	std::atomic<uint64_t> m_count;
+	std::atomic<uint64_t> m_totalNs;
+	std::atomic<uint64_t> m_maxNs;
+
+	LatencyHistogram()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		for ( auto& bucket : m_buckets )
+		{
+			bucket.store( 0, std::memory_order_relaxed );
+		}
+		m_count.store( 0, std::memory_order_relaxed );
+		m_totalNs.store( 0, std::memory_order_relaxed );
+		m_maxNs.store( 0, std::memory_order_relaxed );
+	}
+
+	static int BucketFor( uint64_t ns )
+	{
+		int bucket = 0;
+		while ( ns > 1 && bucket < NUM_BUCKETS - 1 )
+		{
+			ns >>= 1;
+			bucket++;
+		}
+		return bucket;
+	}
+
+	void Record( uint64_t ns )
+	{
+		Add( m_buckets[BucketFor( ns )], 1 );
+		Add( m_count, 1 );
+		Add( m_totalNs, ns );
+		if ( ns > m_maxNs.load( std::memory_order_relaxed ) )
+		{
+			m_maxNs.store( ns, std::memory_order_relaxed );
+		}
+	}
+
+	/*! \brief Adds #other's counts into this one, only for histograms nobody else is writing to */
+	void Merge( const LatencyHistogram& other )
+	{
+		for ( int i = 0; i < NUM_BUCKETS; i++ )
+		{
+			Add( m_buckets[i], other.m_buckets[i].load( std::memory_order_relaxed ) );
+		}
+		Add( m_count, other.m_count.load( std::memory_order_relaxed ) );
+		Add( m_totalNs, other.m_totalNs.load( std::memory_order_relaxed ) );
+		uint64_t otherMax = other.m_maxNs.load( std::memory_order_relaxed );
+		if ( otherMax > m_maxNs.load( std::memory_order_relaxed ) )
+		{
+			m_maxNs.store( otherMax, std::memory_order_relaxed );
+		}
+	}
+
+	uint64_t Count() const { return m_count.load( std::memory_order_relaxed ); }
+	uint64_t MaxNs() const { return m_maxNs.load( std::memory_order_relaxed ); }
+	uint64_t TotalNs() const { return m_totalNs.load( std::memory_order_relaxed ); }
+
+	double MeanNs() const
+	{
+		uint64_t count = Count();
+		return count ? (double)m_totalNs.load( std::memory_order_relaxed ) / count : 0.0;
+	}
+
+	/*! \return the upper bound of the bucket that #percentile (0-100) of the durations fall into */
+	uint64_t PercentileNs( double percentile ) const
+	{
+		uint64_t count = Count();
+		if ( count == 0 )
+		{
+			return 0;
+		}
+		uint64_t target = (uint64_t)( count * percentile / 100.0 );
+		uint64_t seen = 0;
+		for ( int i = 0; i < NUM_BUCKETS; i++ )
+		{
+			seen += m_buckets[i].load( std::memory_order_relaxed );
+			if ( seen > target )
+			{
+				return (uint64_t)1 << ( i + 1 );
+			}
+		}
+		return MaxNs();
+	}
+
+private:
+	static void Add( std::atomic<uint64_t>& counter, uint64_t value )
+	{
+		//single writer, so no need for a fetch_add
+		counter.store( counter.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+	}
+};
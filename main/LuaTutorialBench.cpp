@@ -0,0 +1,741 @@
+#include "lua.hpp"
+#include "ArenaAllocator.h"
+#include "AutomatedBinding.h"
+#include "NativeVector.h"
+#include "PerfCounters.h"
+#include "SlotMap.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <assert.h>
+#include <string.h>
+
+// Microbenchmarks of the binding, allocation & call paths.
+// Every binding benchmark runs the same script against the automated rttr binding (CreateScript)
+// and the hand-written binding style from main.cpp, so the two can be compared.
+// usage: LuaTutorialBench [results.json]
+
+namespace HandWritten
+{
+	struct Sprite
+	{
+		int x;
+		int y;
+
+		Sprite() : x(0), y(0) {}
+
+		int Move(int velX, int velY)
+		{
+			x += velX;
+			y += velY;
+			return x + y;
+		}
+	};
+
+	int Add(lua_State* L)
+	{
+		short a = (short)lua_tonumber(L, 1);
+		short b = (short)lua_tonumber(L, 2);
+		lua_pushnumber(L, a + b);
+		return 1;
+	}
+
+	int CreateSprite(lua_State* L)
+	{
+		void* pointerToASprite = lua_newuserdata(L, sizeof(Sprite));
+		new (pointerToASprite) Sprite();
+		luaL_getmetatable(L, "SpriteMetaTable");
+		assert(lua_istable(L, -1));
+		lua_setmetatable(L, -2);
+
+		lua_newtable(L);
+		lua_setuservalue(L, -2);
+		return 1;
+	}
+
+	int DestroySprite(lua_State* L)
+	{
+		Sprite* sprite = (Sprite*)lua_touserdata(L, -1);
+		sprite->~Sprite();
+		return 0;
+	}
+
+	int MoveSprite(lua_State* L)
+	{
+		Sprite* sprite = (Sprite*)lua_touserdata(L, -3);
+		lua_Number velX = lua_tonumber(L, -2);
+		lua_Number velY = lua_tonumber(L, -1);
+		lua_pushnumber(L, sprite->Move((int)velX, (int)velY));
+		return 1;
+	}
+
+	int SpriteIndex(lua_State* L)
+	{
+		Sprite* sprite = (Sprite*)lua_touserdata(L, 1);
+		const char* index = lua_tostring(L, 2);
+		if (strcmp(index, "x") == 0)
+		{
+			lua_pushnumber(L, sprite->x);
+			return 1;
+		}
+		else if (strcmp(index, "y") == 0)
+		{
+			lua_pushnumber(L, sprite->y);
+			return 1;
+		}
+		lua_getuservalue(L, 1);
+		lua_pushvalue(L, 2);
+		lua_gettable(L, -2);
+		if (lua_isnil(L, -1))
+		{
+			lua_getglobal(L, "Sprite");
+			lua_pushstring(L, index);
+			lua_rawget(L, -2);
+		}
+		return 1;
+	}
+
+	int SpriteNewIndex(lua_State* L)
+	{
+		Sprite* sprite = (Sprite*)lua_touserdata(L, 1);
+		const char* index = lua_tostring(L, 2);
+		if (strcmp(index, "x") == 0)
+		{
+			sprite->x = (int)lua_tonumber(L, 3);
+		}
+		else if (strcmp(index, "y") == 0)
+		{
+			sprite->y = (int)lua_tonumber(L, 3);
+		}
+		else
+		{
+			lua_getuservalue(L, 1);
+			lua_pushvalue(L, 2);
+			lua_pushvalue(L, 3);
+			lua_settable(L, -3);
+		}
+		return 0;
+	}
+
+	/*! \brief The same globals CreateScript makes for Sprite & Global.Add, bound by hand */
+	void Bind(lua_State* L)
+	{
+		lua_newtable(L);
+		lua_pushcfunction(L, Add);
+		lua_setfield(L, -2, "Add");
+		lua_setglobal(L, "Global");
+
+		lua_newtable(L);
+		lua_pushcfunction(L, CreateSprite);
+		lua_setfield(L, -2, "new");
+		lua_pushcfunction(L, MoveSprite);
+		lua_setfield(L, -2, "Move");
+		lua_setglobal(L, "Sprite");
+
+		luaL_newmetatable(L, "SpriteMetaTable");
+		lua_pushcfunction(L, DestroySprite);
+		lua_setfield(L, -2, "__gc");
+		lua_pushcfunction(L, SpriteIndex);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, SpriteNewIndex);
+		lua_setfield(L, -2, "__newindex");
+		lua_pop(L, 1);
+	}
+}
+
+enum class Binding
+{
+	Rttr,
+	HandWritten,
+	None,
+};
+
+static const char* BindingName( Binding binding )
+{
+	switch ( binding )
+	{
+	case Binding::Rttr: return "rttr";
+	case Binding::HandWritten: return "handwritten";
+	default: return "none";
+	}
+}
+
+struct BenchResult
+{
+	std::string name;
+	Binding binding;
+	int iterations;			//operations per repetition
+	double medianNsPerOp;
+	double minNsPerOp;
+	double cyclesPerOp;		//0 without hardware counters
+	double instructionsPerOp;
+	double cacheMissesPerOp;
+	double branchMissesPerOp;
+};
+
+static bool s_hasHardwareCounters = false;
+static constexpr int NUM_REPETITIONS = 7;
+
+/*! \brief Runs #run (which does #iterations operations) NUM_REPETITIONS times after a warm up, keeps the median */
+template< typename RUN >
+static BenchResult Measure( const char* name, Binding binding, int iterations, RUN run )
+{
+	run();	//warm up
+
+	std::vector<PerfSample> samples;
+	for ( int i = 0; i < NUM_REPETITIONS; i++ )
+	{
+		PerfSample start = ReadPerfCounters();
+		run();
+		samples.push_back( ReadPerfCounters() - start );
+	}
+	std::sort( samples.begin(), samples.end(), []( const PerfSample& a, const PerfSample& b )
+	{
+		return a.wallNs < b.wallNs;
+	} );
+	const PerfSample& median = samples[NUM_REPETITIONS / 2];
+	s_hasHardwareCounters = median.hasHardwareCounters;
+
+	BenchResult result;
+	result.name = name;
+	result.binding = binding;
+	result.iterations = iterations;
+	result.medianNsPerOp = (double)median.wallNs / iterations;
+	result.minNsPerOp = (double)samples.front().wallNs / iterations;
+	result.cyclesPerOp = (double)median.cycles / iterations;
+	result.instructionsPerOp = (double)median.instructions / iterations;
+	result.cacheMissesPerOp = (double)median.cacheMisses / iterations;
+	result.branchMissesPerOp = (double)median.branchMisses / iterations;
+	printf( "%-24s %-12s %10.1f ns/op", name, BindingName( binding ), result.medianNsPerOp );
+	if ( median.hasHardwareCounters )
+	{
+		printf( " %10.1f cycles/op %10.1f instructions/op", result.cyclesPerOp, result.instructionsPerOp );
+	}
+	printf( "\n" );
+	return result;
+}
+
+/*! \brief A state with #binding, made from its own arena */
+struct BenchState
+{
+	static constexpr int POOL_SIZE = 1024 * 1024 * 8;
+
+	std::vector<char> m_memory;
+	ArenaAllocator m_allocator;
+	lua_State* m_L;
+
+	/*! \param open adds anything else the script needs, can be nullptr */
+	BenchState( Binding binding, const char* script, void (*open)( lua_State* ) = nullptr ) :
+		m_memory( POOL_SIZE ),
+		m_allocator( m_memory.data(), &m_memory[POOL_SIZE - 1] )
+	{
+		if ( binding == Binding::Rttr )
+		{
+			m_L = CreateScript( m_allocator );
+		}
+		else
+		{
+			m_L = lua_newstate( ArenaAllocator::l_alloc, &m_allocator );
+			if ( binding == Binding::HandWritten )
+			{
+				HandWritten::Bind( m_L );
+			}
+		}
+		if ( open )
+		{
+			open( m_L );
+		}
+		if ( luaL_dostring( m_L, script ) != LUA_OK )
+		{
+			printf( "benchmark script error: %s\n", lua_tostring( m_L, -1 ) );
+			lua_pop( m_L, 1 );
+		}
+	}
+
+	~BenchState()
+	{
+		lua_close( m_L );
+	}
+
+	/*! \brief Calls the script's Bench( n ) */
+	void RunBench( int n )
+	{
+		lua_getglobal( m_L, "Bench" );
+		lua_pushinteger( m_L, n );
+		if ( lua_pcall( m_L, 1, 0, 0 ) != LUA_OK )
+		{
+			printf( "Bench failed: %s\n", lua_tostring( m_L, -1 ) );
+			lua_pop( m_L, 1 );
+		}
+	}
+};
+
+/*! \brief A benchmark that's a Lua loop of #iterations operations */
+static BenchResult ScriptBench( const char* name, Binding binding, int iterations, const char* script, bool collectAfter = false,
+	void (*open)( lua_State* ) = nullptr )
+{
+	BenchState state( binding, script, open );
+	return Measure( name, binding, iterations, [&]()
+	{
+		state.RunBench( iterations );
+		if ( collectAfter )
+		{
+			lua_gc( state.m_L, LUA_GCCOLLECT, 0 );
+		}
+	} );
+}
+
+static void RunBindingBenchmarks( Binding binding, std::vector<BenchResult>& results )
+{
+	constexpr int N = 1000000;
+
+	results.push_back( ScriptBench( "global_call", binding, N, R"(
+		function Bench( n )
+			local total = 0
+			for i = 1, n do
+				total = total + Global.Add( 1, 2 )
+			end
+		end
+		)" ) );
+
+	results.push_back( ScriptBench( "method_call", binding, N, R"(
+		spr = Sprite.new()
+		function Bench( n )
+			local s = spr
+			for i = 1, n do
+				s:Move( 1, -1 )
+			end
+		end
+		)" ) );
+
+	if ( binding == Binding::Rttr )
+	{
+		//a base class method, found in the derived class's flattened members
+		results.push_back( ScriptBench( "inherited_method_call", binding, N, R"(
+			spr = AnimatedSprite.new()
+			function Bench( n )
+				local s = spr
+				for i = 1, n do
+					s:Move( 1, -1 )
+				end
+			end
+			)" ) );
+	}
+
+	results.push_back( ScriptBench( "property_get", binding, N, R"(
+		spr = Sprite.new()
+		function Bench( n )
+			local s = spr
+			local total = 0
+			for i = 1, n do
+				total = total + s.x
+			end
+		end
+		)" ) );
+
+	results.push_back( ScriptBench( "property_set", binding, N, R"(
+		spr = Sprite.new()
+		function Bench( n )
+			local s = spr
+			for i = 1, n do
+				s.x = i
+			end
+		end
+		)" ) );
+
+	results.push_back( ScriptBench( "construct_and_gc", binding, N / 10, R"(
+		function Bench( n )
+			for i = 1, n do
+				local s = Sprite.new()
+			end
+		end
+		)", true ) );
+
+	//into Lua from C++
+	{
+		constexpr int NUM_CALLS = N / 4;
+		BenchState state( binding, "function Noop( a, b ) return a end" );
+		int a = 1;
+		int b = 2;
+		results.push_back( Measure( "call_script_function", binding, NUM_CALLS, [&]()
+		{
+			for ( int i = 0; i < NUM_CALLS; i++ )
+			{
+				CallScriptFunction( state.m_L, "Noop", a, b );
+			}
+		} ) );
+	}
+
+	//state creation, including the binding
+	{
+		constexpr int NUM_STATES = 1000;
+		constexpr int POOL_SIZE = 1024 * 64;
+		std::vector<char> memory( POOL_SIZE );
+		ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+		results.push_back( Measure( "create_state", binding, NUM_STATES, [&]()
+		{
+			for ( int i = 0; i < NUM_STATES; i++ )
+			{
+				pool.Reset();
+				lua_State* L = nullptr;
+				if ( binding == Binding::Rttr )
+				{
+					L = CreateScript( pool );
+				}
+				else
+				{
+					L = lua_newstate( ArenaAllocator::l_alloc, &pool );
+					HandWritten::Bind( L );
+				}
+				lua_close( L );
+			}
+		} ) );
+	}
+}
+
+/*! \brief Moving lots of sprites, one boxed Sprite at a time vs a SpriteBatch */
+static void RunSpriteBatchBenchmarks( std::vector<BenchResult>& results )
+{
+	constexpr int NUM_SPRITES = 10000;
+	constexpr int NUM_FRAMES = 10;
+	constexpr int NUM_MOVES = NUM_SPRITES * NUM_FRAMES;
+
+	results.push_back( ScriptBench( "move_sprites_per_object", Binding::Rttr, NUM_MOVES, R"(
+		sprites = {}
+		for i = 1, 10000 do
+			sprites[i] = Sprite.new()
+		end
+		function Bench( n )
+			local all = sprites
+			for frame = 1, n // #all do
+				for i = 1, #all do
+					all[i]:Move( 1, -1 )
+				end
+			end
+		end
+		)" ) );
+
+	results.push_back( ScriptBench( "move_sprites_batch_index", Binding::Rttr, NUM_MOVES, R"(
+		batch = SpriteBatch.new()
+		for i = 1, 10000 do
+			batch:Add( i, i )
+		end
+		function Bench( n )
+			local b = batch
+			local count = b:Count()
+			for frame = 1, n // count do
+				for i = 0, count - 1 do
+					b:Move( i, 1, -1 )
+				end
+			end
+		end
+		)" ) );
+
+	results.push_back( ScriptBench( "move_sprites_batch_moveall", Binding::Rttr, NUM_MOVES, R"(
+		batch = SpriteBatch.new()
+		for i = 1, 10000 do
+			batch:Add( i, i )
+		end
+		function Bench( n )
+			for frame = 1, n // batch:Count() do
+				batch:MoveAll( 1, -1 )
+			end
+		end
+		)" ) );
+
+	results.push_back( ScriptBench( "move_sprites_batch_integrate", Binding::Rttr, NUM_MOVES, R"(
+		batch = SpriteBatch.new()
+		for i = 1, 10000 do
+			local s = batch:Add( i, i )
+			batch:SetVelocity( s, i % 3 - 1, 1 )
+		end
+		function Bench( n )
+			for frame = 1, n // batch:Count() do
+				batch:Integrate()
+			end
+		end
+		)" ) );
+}
+
+namespace TableVector
+{
+	/*! \brief The table based vector from main.cpp's metatables section, with y added */
+	int CreateVector2D(lua_State* L)
+	{
+		lua_createtable(L, 0, 2);
+		lua_pushnumber(L, luaL_optnumber(L, 1, 0));
+		lua_setfield(L, -2, "x");
+		lua_pushnumber(L, luaL_optnumber(L, 2, 0));
+		lua_setfield(L, -2, "y");
+		luaL_setmetatable(L, "VectorMetaTable");
+		return 1;
+	}
+
+	int Add(lua_State* L)
+	{
+		lua_getfield(L, 1, "x");
+		lua_getfield(L, 2, "x");
+		lua_Number x = lua_tonumber(L, -2) + lua_tonumber(L, -1);
+		lua_getfield(L, 1, "y");
+		lua_getfield(L, 2, "y");
+		lua_Number y = lua_tonumber(L, -2) + lua_tonumber(L, -1);
+		lua_settop(L, 0);
+		lua_pushnumber(L, x);
+		lua_pushnumber(L, y);
+		return CreateVector2D(L);
+	}
+
+	void Open(lua_State* L)
+	{
+		lua_pushcfunction(L, CreateVector2D);
+		lua_setglobal(L, "CreateVector");
+		luaL_newmetatable(L, "VectorMetaTable");
+		lua_pushcfunction(L, Add);
+		lua_setfield(L, -2, "__add");
+		lua_pop(L, 1);
+	}
+}
+
+/*! \brief Vector addition, a Lua table per result vs a native vector userdata vs in place */
+static void RunVectorBenchmarks( std::vector<BenchResult>& results )
+{
+	constexpr int N = 1000000;
+
+	results.push_back( ScriptBench( "vec2_add_table", Binding::HandWritten, N, R"(
+		a = CreateVector( 1, 2 )
+		b = CreateVector( 3, 4 )
+		function Bench( n )
+			local a, b, c = a, b
+			for i = 1, n do
+				c = a + b
+			end
+		end
+		)", true, TableVector::Open ) );
+
+	results.push_back( ScriptBench( "vec2_add_userdata", Binding::None, N, R"(
+		a = Vec2.new( 1, 2 )
+		b = Vec2.new( 3, 4 )
+		function Bench( n )
+			local a, b, c = a, b
+			for i = 1, n do
+				c = a + b
+			end
+		end
+		)", true, OpenNativeVectors ) );
+
+	results.push_back( ScriptBench( "vec2_add_in_place", Binding::None, N, R"(
+		a = Vec2.new( 1, 2 )
+		b = Vec2.new( 3, 4 )
+		c = Vec2.new()
+		function Bench( n )
+			local a, b, c = a, b, c
+			for i = 1, n do
+				c:copy( a ):addInPlace( b )
+			end
+		end
+		)", true, OpenNativeVectors ) );
+
+	results.push_back( ScriptBench( "vec2_add_temp", Binding::None, N, R"(
+		a = Vec2.new( 1, 2 )
+		b = Vec2.new( 3, 4 )
+		function Bench( n )
+			local a, b, temp = a, b, Vec2.temp
+			for i = 1, n do
+				local c = temp():copy( a ):addInPlace( b )
+			end
+		end
+		)", true, OpenNativeVectors ) );
+}
+
+namespace SpriteManagers
+{
+	struct Sprite
+	{
+		int x;
+		int y;
+		SlotHandle handle;
+	};
+
+	/*! \brief The SpriteManager from main.cpp before it used a SlotMap, forgetting is a scan & erase */
+	struct VectorSpriteManager
+	{
+		std::vector<Sprite*> m_sprites;
+
+		void LookAfterSprite( Sprite* sprite )
+		{
+			m_sprites.push_back( sprite );
+		}
+
+		void ForgetSprite( Sprite* sprite )
+		{
+			auto it = std::find( m_sprites.begin(), m_sprites.end(), sprite );
+			if ( it != m_sprites.end() )
+			{
+				m_sprites.erase( it );
+			}
+		}
+	};
+
+	struct SlotMapSpriteManager
+	{
+		SlotMap<Sprite*> m_sprites;
+
+		void LookAfterSprite( Sprite* sprite )
+		{
+			sprite->handle = m_sprites.Insert( sprite );
+		}
+
+		void ForgetSprite( Sprite* sprite )
+		{
+			m_sprites.Remove( sprite->handle );
+		}
+	};
+}
+
+/*! \brief 100k live sprites, with sprites dying (as their __gc would) & being made in a random order */
+static void RunSpriteManagerBenchmarks( std::vector<BenchResult>& results )
+{
+	using namespace SpriteManagers;
+	constexpr int NUM_SPRITES = 100000;
+	constexpr int NUM_CHURNS = 10000;
+	std::vector<Sprite> sprites( NUM_SPRITES );
+
+	auto churn = [&]( const char* name, auto& manager )
+	{
+		for ( Sprite& sprite : sprites )
+		{
+			manager.LookAfterSprite( &sprite );
+		}
+		uint32_t seed = 12345;
+		results.push_back( Measure( name, Binding::None, NUM_CHURNS, [&]()
+		{
+			for ( int i = 0; i < NUM_CHURNS; i++ )
+			{
+				seed = seed * 1664525u + 1013904223u;
+				Sprite* sprite = &sprites[( seed >> 8 ) % NUM_SPRITES];
+				manager.ForgetSprite( sprite );
+				manager.LookAfterSprite( sprite );
+			}
+		} ) );
+	};
+
+	VectorSpriteManager vectorManager;
+	churn( "sprite_churn_vector", vectorManager );
+	SlotMapSpriteManager slotMapManager;
+	churn( "sprite_churn_slotmap", slotMapManager );
+
+	results.push_back( Measure( "sprite_update_slotmap", Binding::None, NUM_SPRITES, [&]()
+	{
+		for ( Sprite* sprite : slotMapManager.m_sprites )
+		{
+			sprite->x += 1;
+			sprite->y -= 1;
+		}
+	} ) );
+
+	SlotHandle stale = sprites[0].handle;
+	slotMapManager.ForgetSprite( &sprites[0] );
+	assert( slotMapManager.m_sprites.Get( stale ) == nullptr );
+	(void)stale;
+}
+
+/*! \brief lua_newstate's usual allocator, as in main.cpp's "lua memory allocation" */
+static void* ReallocAlloc( void* /*ud*/, void* ptr, size_t /*osize*/, size_t nsize )
+{
+	if ( nsize == 0 )
+	{
+		free( ptr );
+		return nullptr;
+	}
+	return realloc( ptr, nsize );
+}
+
+static void RunAllocatorBenchmarks( std::vector<BenchResult>& results )
+{
+	constexpr int NUM_TABLES = 100000;
+	const char* TABLE_CHURN = R"(
+		function Bench( n )
+			local keep = {}
+			for i = 1, n do
+				local t = { i, i + 1, x = i }
+				keep[i % 64 + 1] = t
+			end
+		end
+		)";
+
+	auto churn = [&]( const char* name, lua_Alloc alloc, void* ud, ArenaAllocator* arena )
+	{
+		results.push_back( Measure( name, Binding::None, NUM_TABLES, [&]()
+		{
+			if ( arena )
+			{
+				arena->Reset();
+			}
+			lua_State* L = lua_newstate( alloc, ud );
+			luaL_dostring( L, TABLE_CHURN );
+			lua_getglobal( L, "Bench" );
+			lua_pushinteger( L, NUM_TABLES );
+			lua_pcall( L, 1, 0, 0 );
+			lua_close( L );
+		} ) );
+	};
+
+	churn( "alloc_realloc", ReallocAlloc, nullptr, nullptr );
+
+	GlobalAllocator global;
+	churn( "alloc_global", GlobalAllocator::l_alloc, &global, nullptr );
+
+	constexpr int POOL_SIZE = 1024 * 1024 * 8;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator arena( memory.data(), &memory[POOL_SIZE - 1] );
+	churn( "alloc_arena", ArenaAllocator::l_alloc, &arena, &arena );
+}
+
+static bool WriteJson( const char* fileName, const std::vector<BenchResult>& results )
+{
+	FILE* f = fopen( fileName, "w" );
+	if ( f == nullptr )
+	{
+		printf( "unable to open '%s' for writing\n", fileName );
+		return false;
+	}
+	fprintf( f, "{\n\t\"hardware_counters\": %s,\n\t\"repetitions\": %d,\n\t\"benchmarks\": [\n",
+		s_hasHardwareCounters ? "true" : "false", NUM_REPETITIONS );
+	for ( size_t i = 0; i < results.size(); i++ )
+	{
+		const BenchResult& r = results[i];
+		fprintf( f, "\t\t{ \"name\": \"%s\", \"binding\": \"%s\", \"iterations\": %d, \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f",
+			r.name.c_str(), BindingName( r.binding ), r.iterations, r.medianNsPerOp, r.minNsPerOp );
+		if ( s_hasHardwareCounters )
+		{
+			fprintf( f, ", \"cycles_per_op\": %.3f, \"instructions_per_op\": %.3f, \"cache_misses_per_op\": %.4f, \"branch_misses_per_op\": %.4f",
+				r.cyclesPerOp, r.instructionsPerOp, r.cacheMissesPerOp, r.branchMissesPerOp );
+		}
+		fprintf( f, " }%s\n", i + 1 < results.size() ? "," : "" );
+	}
+	fprintf( f, "\t]\n}\n" );
+	fclose( f );
+	return true;
+}
+
+int main( int argc, char** argv )
+{
+	const char* resultsFile = argc > 1 ? argv[1] : "LuaTutorialBench.json";
+
+	std::vector<BenchResult> results;
+	RunBindingBenchmarks( Binding::Rttr, results );
+	RunBindingBenchmarks( Binding::HandWritten, results );
+	RunSpriteBatchBenchmarks( results );
+	RunSpriteManagerBenchmarks( results );
+	RunVectorBenchmarks( results );
+	RunAllocatorBenchmarks( results );
+
+	if ( WriteJson( resultsFile, results ) == false )
+	{
+		return 1;
+	}
+	printf( "results written to %s\n", resultsFile );
+	return 0;
+}
@@ -0,0 +1,606 @@
+#include "NativeBuffer.h"
+#include <algorithm>
+#include <string.h>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NATIVE_BUFFER_SSE 1
+#endif
+
+static const char* const BUFFER_TYPE_NAMES[] = { "int16", "int32", "float", "double", nullptr };
+
+static size_t ElementSize( BufferType type )
+{
+	switch ( type )
+	{
+	case BufferType::Int16: return sizeof( int16_t );
+	case BufferType::Int32: return sizeof( int32_t );
+	case BufferType::Float: return sizeof( float );
+	default: return sizeof( double );
+	}
+}
+
+// The bulk operations, plain loops the compiler can vectorise for the integer types
+template< typename T >
+struct BufferOps
+{
+	static void Fill( T* d, size_t n, T v )
+	{
+		std::fill( d, d + n, v );
+	}
+
+	static void Add( T* d, const T* s, size_t n )
+	{
+		for ( size_t i = 0; i < n; i++ )
+		{
+			d[i] = (T)( d[i] + s[i] );
+		}
+	}
+
+	static void Scale( T* d, size_t n, double scale )
+	{
+		for ( size_t i = 0; i < n; i++ )
+		{
+			d[i] = (T)( d[i] * scale );
+		}
+	}
+
+	static double Dot( const T* a, const T* b, size_t n )
+	{
+		double total = 0;
+		for ( size_t i = 0; i < n; i++ )
+		{
+			total += (double)a[i] * b[i];
+		}
+		return total;
+	}
+
+	static double Sum( const T* d, size_t n )
+	{
+		double total = 0;
+		for ( size_t i = 0; i < n; i++ )
+		{
+			total += d[i];
+		}
+		return total;
+	}
+
+	static T Min( const T* d, size_t n )
+	{
+		return *std::min_element( d, d + n );
+	}
+
+	static T Max( const T* d, size_t n )
+	{
+		return *std::max_element( d, d + n );
+	}
+};
+
+#if NATIVE_BUFFER_SSE
+
+// 4 floats at a time, unaligned loads so views over any memory work
+template<>
+struct BufferOps<float>
+{
+	static void Fill( float* d, size_t n, float v )
+	{
+		__m128 v4 = _mm_set1_ps( v );
+		size_t i = 0;
+		for ( ; i + 4 <= n; i += 4 )
+		{
+			_mm_storeu_ps( d + i, v4 );
+		}
+		for ( ; i < n; i++ )
+		{
+			d[i] = v;
+		}
+	}
+
+	static void Add( float* d, const float* s, size_t n )
+	{
+		size_t i = 0;
+		for ( ; i + 4 <= n; i += 4 )
+		{
+			_mm_storeu_ps( d + i, _mm_add_ps( _mm_loadu_ps( d + i ), _mm_loadu_ps( s + i ) ) );
+		}
+		for ( ; i < n; i++ )
+		{
+			d[i] += s[i];
+		}
+	}
+
+	static void Scale( float* d, size_t n, double scale )
+	{
+		__m128 s4 = _mm_set1_ps( (float)scale );
+		size_t i = 0;
+		for ( ; i + 4 <= n; i += 4 )
+		{
+			_mm_storeu_ps( d + i, _mm_mul_ps( _mm_loadu_ps( d + i ), s4 ) );
+		}
+		for ( ; i < n; i++ )
+		{
+			d[i] *= (float)scale;
+		}
+	}
+
+	static float HorizontalAdd( __m128 v )
+	{
+		__m128 shuffled = _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		__m128 sums = _mm_add_ps( v, shuffled );
+		shuffled = _mm_movehl_ps( shuffled, sums );
+		return _mm_cvtss_f32( _mm_add_ss( sums, shuffled ) );
+	}
+
+	static double Dot( const float* a, const float* b, size_t n )
+	{
+		__m128 total4 = _mm_setzero_ps();
+		size_t i = 0;
+		for ( ; i + 4 <= n; i += 4 )
+		{
+			total4 = _mm_add_ps( total4, _mm_mul_ps( _mm_loadu_ps( a + i ), _mm_loadu_ps( b + i ) ) );
+		}
+		double total = HorizontalAdd( total4 );
+		for ( ; i < n; i++ )
+		{
+			total += (double)a[i] * b[i];
+		}
+		return total;
+	}
+
+	static double Sum( const float* d, size_t n )
+	{
+		__m128 total4 = _mm_setzero_ps();
+		size_t i = 0;
+		for ( ; i + 4 <= n; i += 4 )
+		{
+			total4 = _mm_add_ps( total4, _mm_loadu_ps( d + i ) );
+		}
+		double total = HorizontalAdd( total4 );
+		for ( ; i < n; i++ )
+		{
+			total += d[i];
+		}
+		return total;
+	}
+
+	template< typename OP >
+	static float Reduce( const float* d, size_t n, OP op4, const float& (*op1)( const float&, const float& ) )
+	{
+		size_t i = 0;
+		float result = d[0];
+		if ( n >= 4 )
+		{
+			__m128 result4 = _mm_loadu_ps( d );
+			for ( i = 4; i + 4 <= n; i += 4 )
+			{
+				result4 = op4( result4, _mm_loadu_ps( d + i ) );
+			}
+			float lanes[4];
+			_mm_storeu_ps( lanes, result4 );
+			result = op1( op1( lanes[0], lanes[1] ), op1( lanes[2], lanes[3] ) );
+		}
+		for ( ; i < n; i++ )
+		{
+			result = op1( result, d[i] );
+		}
+		return result;
+	}
+
+	static float Min( const float* d, size_t n )
+	{
+		return Reduce( d, n, []( __m128 a, __m128 b ) { return _mm_min_ps( a, b ); }, std::min<float> );
+	}
+
+	static float Max( const float* d, size_t n )
+	{
+		return Reduce( d, n, []( __m128 a, __m128 b ) { return _mm_max_ps( a, b ); }, std::max<float> );
+	}
+};
+
+// 2 doubles at a time
+template<>
+struct BufferOps<double>
+{
+	static void Fill( double* d, size_t n, double v )
+	{
+		__m128d v2 = _mm_set1_pd( v );
+		size_t i = 0;
+		for ( ; i + 2 <= n; i += 2 )
+		{
+			_mm_storeu_pd( d + i, v2 );
+		}
+		for ( ; i < n; i++ )
+		{
+			d[i] = v;
+		}
+	}
+
+	static void Add( double* d, const double* s, size_t n )
+	{
+		size_t i = 0;
+		for ( ; i + 2 <= n; i += 2 )
+		{
+			_mm_storeu_pd( d + i, _mm_add_pd( _mm_loadu_pd( d + i ), _mm_loadu_pd( s + i ) ) );
+		}
+		for ( ; i < n; i++ )
+		{
+			d[i] += s[i];
+		}
+	}
+
+	static void Scale( double* d, size_t n, double scale )
+	{
+		__m128d s2 = _mm_set1_pd( scale );
+		size_t i = 0;
+		for ( ; i + 2 <= n; i += 2 )
+		{
+			_mm_storeu_pd( d + i, _mm_mul_pd( _mm_loadu_pd( d + i ), s2 ) );
+		}
+		for ( ; i < n; i++ )
+		{
+			d[i] *= scale;
+		}
+	}
+
+	static double HorizontalAdd( __m128d v )
+	{
+		return _mm_cvtsd_f64( _mm_add_sd( v, _mm_unpackhi_pd( v, v ) ) );
+	}
+
+	static double Dot( const double* a, const double* b, size_t n )
+	{
+		__m128d total2 = _mm_setzero_pd();
+		size_t i = 0;
+		for ( ; i + 2 <= n; i += 2 )
+		{
+			total2 = _mm_add_pd( total2, _mm_mul_pd( _mm_loadu_pd( a + i ), _mm_loadu_pd( b + i ) ) );
+		}
+		double total = HorizontalAdd( total2 );
+		for ( ; i < n; i++ )
+		{
+			total += a[i] * b[i];
+		}
+		return total;
+	}
+
+	static double Sum( const double* d, size_t n )
+	{
+		__m128d total2 = _mm_setzero_pd();
+		size_t i = 0;
+		for ( ; i + 2 <= n; i += 2 )
+		{
+			total2 = _mm_add_pd( total2, _mm_loadu_pd( d + i ) );
+		}
+		double total = HorizontalAdd( total2 );
+		for ( ; i < n; i++ )
+		{
+			total += d[i];
+		}
+		return total;
+	}
+
+	static double Min( const double* d, size_t n )
+	{
+		return *std::min_element( d, d + n );
+	}
+
+	static double Max( const double* d, size_t n )
+	{
+		return *std::max_element( d, d + n );
+	}
+};
+
+#endif
+
+/*! \brief Calls FUNC<T>( args... ) with T the element type of #type */
+template< template< typename > class FUNC, typename... ARGS >
+static auto DispatchOnType( BufferType type, ARGS&&... args ) -> decltype( FUNC<float>::Run( args... ) )
+{
+	switch ( type )
+	{
+	case BufferType::Int16: return FUNC<int16_t>::Run( args... );
+	case BufferType::Int32: return FUNC<int32_t>::Run( args... );
+	case BufferType::Float: return FUNC<float>::Run( args... );
+	default: return FUNC<double>::Run( args... );
+	}
+}
+
+template< typename T >
+struct GetElement
+{
+	static void Run( lua_State* L, const NativeBuffer& b, size_t i )
+	{
+		T value = ( (const T*)b.m_data )[i];
+		if ( std::is_integral<T>::value )
+		{
+			lua_pushinteger( L, (lua_Integer)value );
+		}
+		else
+		{
+			lua_pushnumber( L, (lua_Number)value );
+		}
+	}
+};
+
+template< typename T >
+struct SetElement
+{
+	static void Run( lua_State* L, NativeBuffer& b, size_t i, int valueIdx )
+	{
+		( (T*)b.m_data )[i] = (T)lua_tonumber( L, valueIdx );
+	}
+};
+
+NativeBuffer* ToNativeBuffer( lua_State* L, int idx )
+{
+	return (NativeBuffer*)luaL_testudata( L, idx, NATIVE_BUFFER_METATABLE );
+}
+
+static NativeBuffer& CheckBuffer( lua_State* L, int idx )
+{
+	return *(NativeBuffer*)luaL_checkudata( L, idx, NATIVE_BUFFER_METATABLE );
+}
+
+/*! \brief The other buffer of a binary operation, must match #b */
+static NativeBuffer& CheckMatchingBuffer( lua_State* L, int idx, const NativeBuffer& b )
+{
+	NativeBuffer& other = CheckBuffer( L, idx );
+	if ( other.m_type != b.m_type || other.m_length != b.m_length )
+	{
+		luaL_error( L, "buffers don't match, %s[%d] and %s[%d]",
+			BUFFER_TYPE_NAMES[(int)b.m_type], (int)b.m_length, BUFFER_TYPE_NAMES[(int)other.m_type], (int)other.m_length );
+	}
+	return other;
+}
+
+static NativeBuffer* PushBufferHeader( lua_State* L, size_t extraBytes )
+{
+	NativeBuffer* b = (NativeBuffer*)lua_newuserdata( L, sizeof( NativeBuffer ) + extraBytes );
+	luaL_setmetatable( L, NATIVE_BUFFER_METATABLE );
+	return b;
+}
+
+/*! \return the most elements of #type a buffer can hold without its size in bytes overflowing */
+static size_t MaxBufferLength( BufferType type )
+{
+	return ( SIZE_MAX - 15 - sizeof( NativeBuffer ) ) / ElementSize( type );
+}
+
+NativeBuffer* PushNativeBuffer( lua_State* L, BufferType type, size_t length )
+{
+	if ( length > MaxBufferLength( type ) )
+	{
+		luaL_error( L, "buffer length %f is too large", (double)length );
+	}
+
+	//the elements follow the header, 16 byte aligned for SSE (Lua only gives us 8)
+	const size_t dataBytes = ElementSize( type ) * length;
+	NativeBuffer* b = PushBufferHeader( L, dataBytes + 15 );
+	uintptr_t data = ( (uintptr_t)( b + 1 ) + 15 ) & ~(uintptr_t)15;
+	b->m_data = (void*)data;
+	b->m_length = length;
+	b->m_type = type;
+	b->m_isView = false;
+	memset( b->m_data, 0, dataBytes );
+	return b;
+}
+
+NativeBuffer* PushNativeBufferView( lua_State* L, BufferType type, void* data, size_t length )
+{
+	NativeBuffer* b = PushBufferHeader( L, 0 );
+	b->m_data = data;
+	b->m_length = length;
+	b->m_type = type;
+	b->m_isView = true;
+	return b;
+}
+
+static int NewBuffer( lua_State* L )
+{
+	BufferType type = (BufferType)luaL_checkoption( L, 1, nullptr, BUFFER_TYPE_NAMES );
+	lua_Integer length = luaL_checkinteger( L, 2 );
+	luaL_argcheck( L, length >= 0, 2, "negative length" );
+	luaL_argcheck( L, (lua_Unsigned)length <= MaxBufferLength( type ), 2, "length too large" );
+	PushNativeBuffer( L, type, (size_t)length );
+	return 1;
+}
+
+static int BufferIndex( lua_State* L )
+{
+	// 1 - buffer, 2 - key
+	NativeBuffer& b = *(NativeBuffer*)lua_touserdata( L, 1 );
+	int isInteger = 0;
+	lua_Integer i = lua_tointegerx( L, 2, &isInteger );
+	if ( isInteger )
+	{
+		if ( i < 1 || (size_t)i > b.m_length )
+		{
+			return 0;	//nil, like reading past the end of a table
+		}
+		DispatchOnType<GetElement>( b.m_type, L, b, (size_t)( i - 1 ) );
+		return 1;
+	}
+
+	//a method name
+	lua_pushvalue( L, 2 );
+	lua_rawget( L, lua_upvalueindex( 1 ) );
+	return 1;
+}
+
+static int BufferNewIndex( lua_State* L )
+{
+	// 1 - buffer, 2 - index, 3 - value
+	NativeBuffer& b = *(NativeBuffer*)lua_touserdata( L, 1 );
+	int isInteger = 0;
+	lua_Integer i = lua_tointegerx( L, 2, &isInteger );
+	if ( isInteger == false || i < 1 || (size_t)i > b.m_length )
+	{
+		return luaL_error( L, "buffer index out of range, 1 to %d", (int)b.m_length );
+	}
+	luaL_checknumber( L, 3 );
+	DispatchOnType<SetElement>( b.m_type, L, b, (size_t)( i - 1 ), 3 );
+	return 0;
+}
+
+static int BufferLength( lua_State* L )
+{
+	lua_pushinteger( L, (lua_Integer)CheckBuffer( L, 1 ).m_length );
+	return 1;
+}
+
+template< typename T >
+struct FillOp
+{
+	static void Run( NativeBuffer& b, lua_Number value ) { BufferOps<T>::Fill( (T*)b.m_data, b.m_length, (T)value ); }
+};
+
+template< typename T >
+struct AddOp
+{
+	static void Run( NativeBuffer& b, const NativeBuffer& other ) { BufferOps<T>::Add( (T*)b.m_data, (const T*)other.m_data, b.m_length ); }
+};
+
+template< typename T >
+struct ScaleOp
+{
+	static void Run( NativeBuffer& b, lua_Number scale ) { BufferOps<T>::Scale( (T*)b.m_data, b.m_length, scale ); }
+};
+
+template< typename T >
+struct DotOp
+{
+	static double Run( const NativeBuffer& b, const NativeBuffer& other ) { return BufferOps<T>::Dot( (const T*)b.m_data, (const T*)other.m_data, b.m_length ); }
+};
+
+template< typename T >
+struct SumOp
+{
+	static double Run( const NativeBuffer& b ) { return BufferOps<T>::Sum( (const T*)b.m_data, b.m_length ); }
+};
+
+template< typename T >
+struct MinOp
+{
+	static double Run( const NativeBuffer& b ) { return BufferOps<T>::Min( (const T*)b.m_data, b.m_length ); }
+};
+
+template< typename T >
+struct MaxOp
+{
+	static double Run( const NativeBuffer& b ) { return BufferOps<T>::Max( (const T*)b.m_data, b.m_length ); }
+};
+
+static int BufferFill( lua_State* L )
+{
+	NativeBuffer& b = CheckBuffer( L, 1 );
+	DispatchOnType<FillOp>( b.m_type, b, luaL_checknumber( L, 2 ) );
+	lua_settop( L, 1 );
+	return 1;	//the buffer, so calls can be chained
+}
+
+static int BufferAdd( lua_State* L )
+{
+	NativeBuffer& b = CheckBuffer( L, 1 );
+	NativeBuffer& other = CheckMatchingBuffer( L, 2, b );
+	DispatchOnType<AddOp>( b.m_type, b, other );
+	lua_settop( L, 1 );
+	return 1;
+}
+
+static int BufferScale( lua_State* L )
+{
+	NativeBuffer& b = CheckBuffer( L, 1 );
+	DispatchOnType<ScaleOp>( b.m_type, b, luaL_checknumber( L, 2 ) );
+	lua_settop( L, 1 );
+	return 1;
+}
+
+static int BufferDot( lua_State* L )
+{
+	NativeBuffer& b = CheckBuffer( L, 1 );
+	NativeBuffer& other = CheckMatchingBuffer( L, 2, b );
+	lua_pushnumber( L, DispatchOnType<DotOp>( b.m_type, b, other ) );
+	return 1;
+}
+
+static int BufferSum( lua_State* L )
+{
+	NativeBuffer& b = CheckBuffer( L, 1 );
+	lua_pushnumber( L, DispatchOnType<SumOp>( b.m_type, b ) );
+	return 1;
+}
+
+static int BufferMin( lua_State* L )
+{
+	NativeBuffer& b = CheckBuffer( L, 1 );
+	if ( b.m_length == 0 )
+	{
+		return 0;
+	}
+	lua_pushnumber( L, DispatchOnType<MinOp>( b.m_type, b ) );
+	return 1;
+}
+
+static int BufferMax( lua_State* L )
+{
+	NativeBuffer& b = CheckBuffer( L, 1 );
+	if ( b.m_length == 0 )
+	{
+		return 0;
+	}
+	lua_pushnumber( L, DispatchOnType<MaxOp>( b.m_type, b ) );
+	return 1;
+}
+
+/*! \brief b:view( first, count ), a buffer sharing b's memory, which keeps b alive */
+static int BufferView( lua_State* L )
+{
+	NativeBuffer& b = CheckBuffer( L, 1 );
+	lua_Integer first = luaL_checkinteger( L, 2 );
+	lua_Integer count = luaL_optinteger( L, 3, (lua_Integer)b.m_length - first + 1 );
+	luaL_argcheck( L, first >= 1 && count >= 0 && (size_t)( first - 1 + count ) <= b.m_length, 2, "view out of range" );
+	char* data = (char*)b.m_data + ( first - 1 ) * ElementSize( b.m_type );
+	PushNativeBufferView( L, b.m_type, data, (size_t)count );
+	lua_pushvalue( L, 1 );
+	lua_setuservalue( L, -2 );
+	return 1;
+}
+
+static int BufferTypeName( lua_State* L )
+{
+	lua_pushstring( L, BUFFER_TYPE_NAMES[(int)CheckBuffer( L, 1 ).m_type] );
+	return 1;
+}
+
+void OpenNativeBuffers( lua_State* L )
+{
+	static const luaL_Reg METHODS[] =
+	{
+		{ "fill", BufferFill },
+		{ "add", BufferAdd },
+		{ "scale", BufferScale },
+		{ "dot", BufferDot },
+		{ "sum", BufferSum },
+		{ "min", BufferMin },
+		{ "max", BufferMax },
+		{ "view", BufferView },
+		{ "type", BufferTypeName },
+		{ nullptr, nullptr }
+	};
+
+	luaL_newmetatable( L, NATIVE_BUFFER_METATABLE );
+	luaL_newlib( L, METHODS );
+	lua_pushcclosure( L, BufferIndex, 1 );		//the methods are __index's upvalue
+	lua_setfield( L, -2, "__index" );
+	lua_pushcfunction( L, BufferNewIndex );
+	lua_setfield( L, -2, "__newindex" );
+	lua_pushcfunction( L, BufferLength );
+	lua_setfield( L, -2, "__len" );
+	lua_pop( L, 1 );
+
+	lua_createtable( L, 0, 1 );
+	lua_pushcfunction( L, NewBuffer );
+	lua_setfield( L, -2, "new" );
+	lua_setglobal( L, "Buffer" );
+}
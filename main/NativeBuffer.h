@@ -0,0 +1,48 @@
+#pragma once
+#include "lua.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+/*! \brief The element types a NativeBuffer can hold */
+enum class BufferType
+{
+	Int16,
+	Int32,
+	Float,
+	Double,
+};
+
+/*! \brief A typed array userdata, so scripts can work on large numeric data without a Lua table.
+*	From Lua (1 based, like tables):
+*		local b = Buffer.new( "float", 1024 )
+*		b[1] = 2.5; local n = #b
+*		b:fill( 1 ) b:add( other ) b:scale( 2 ) b:dot( other ) b:sum() b:min() b:max() b:view( first, count )
+*	The bulk operations run in native code, SSE for float & double. */
+struct NativeBuffer
+{
+	void* m_data;
+	size_t m_length;		//in elements
+	BufferType m_type;
+	bool m_isView;			//m_data belongs to someone else
+};
+
+constexpr const char* NATIVE_BUFFER_METATABLE = "NativeBuffer_MT_";
+
+/*! \brief Creates the global "Buffer" table & the buffer metatable, call once per state */
+void OpenNativeBuffers( lua_State* L );
+
+/*! \brief Pushes a new buffer of #length zeroed elements, the memory lives in the userdata.
+*	Raises a Lua error if #length elements can't be addressed in a size_t. */
+NativeBuffer* PushNativeBuffer( lua_State* L, BufferType type, size_t length );
+
+/*! \brief Pushes a buffer over #data without copying it.
+*	NOTE: #data must outlive every use of the buffer from Lua. */
+NativeBuffer* PushNativeBufferView( lua_State* L, BufferType type, void* data, size_t length );
+
+inline NativeBuffer* PushNativeBufferView( lua_State* L, int16_t* data, size_t length ) { return PushNativeBufferView( L, BufferType::Int16, data, length ); }
+inline NativeBuffer* PushNativeBufferView( lua_State* L, int32_t* data, size_t length ) { return PushNativeBufferView( L, BufferType::Int32, data, length ); }
+inline NativeBuffer* PushNativeBufferView( lua_State* L, float* data, size_t length ) { return PushNativeBufferView( L, BufferType::Float, data, length ); }
+inline NativeBuffer* PushNativeBufferView( lua_State* L, double* data, size_t length ) { return PushNativeBufferView( L, BufferType::Double, data, length ); }
+
+/*! \return the buffer at #idx, or nullptr if it isn't one */
+NativeBuffer* ToNativeBuffer( lua_State* L, int idx );
@@ -0,0 +1,371 @@
+#include "NativeVector.h"
+#include <cmath>
+#include <cstdio>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NATIVE_VECTOR_SSE 1
+#endif
+
+// All 4 lanes every time, the unused ones are 0 and stay 0 (apart from -0 from Negate, which still == 0)
+struct VectorOps
+{
+#if NATIVE_VECTOR_SSE
+	static void Add( float* r, const float* a, const float* b ) { _mm_store_ps( r, _mm_add_ps( _mm_load_ps( a ), _mm_load_ps( b ) ) ); }
+	static void Sub( float* r, const float* a, const float* b ) { _mm_store_ps( r, _mm_sub_ps( _mm_load_ps( a ), _mm_load_ps( b ) ) ); }
+	static void Mul( float* r, const float* a, const float* b ) { _mm_store_ps( r, _mm_mul_ps( _mm_load_ps( a ), _mm_load_ps( b ) ) ); }
+	static void Scale( float* r, const float* a, float s ) { _mm_store_ps( r, _mm_mul_ps( _mm_load_ps( a ), _mm_set1_ps( s ) ) ); }
+	static void Negate( float* r, const float* a ) { _mm_store_ps( r, _mm_sub_ps( _mm_setzero_ps(), _mm_load_ps( a ) ) ); }
+
+	static bool Equal( const float* a, const float* b )
+	{
+		return _mm_movemask_ps( _mm_cmpeq_ps( _mm_load_ps( a ), _mm_load_ps( b ) ) ) == 0xf;
+	}
+
+	static float Dot( const float* a, const float* b )
+	{
+		__m128 products = _mm_mul_ps( _mm_load_ps( a ), _mm_load_ps( b ) );
+		__m128 shuffled = _mm_shuffle_ps( products, products, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		__m128 sums = _mm_add_ps( products, shuffled );
+		shuffled = _mm_movehl_ps( shuffled, sums );
+		return _mm_cvtss_f32( _mm_add_ss( sums, shuffled ) );
+	}
+#else
+	static void Add( float* r, const float* a, const float* b ) { for ( int i = 0; i < 4; i++ ) r[i] = a[i] + b[i]; }
+	static void Sub( float* r, const float* a, const float* b ) { for ( int i = 0; i < 4; i++ ) r[i] = a[i] - b[i]; }
+	static void Mul( float* r, const float* a, const float* b ) { for ( int i = 0; i < 4; i++ ) r[i] = a[i] * b[i]; }
+	static void Scale( float* r, const float* a, float s ) { for ( int i = 0; i < 4; i++ ) r[i] = a[i] * s; }
+	static void Negate( float* r, const float* a ) { for ( int i = 0; i < 4; i++ ) r[i] = 0.0f - a[i]; }
+
+	static bool Equal( const float* a, const float* b )
+	{
+		return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+	}
+
+	static float Dot( const float* a, const float* b )
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+	}
+#endif
+};
+
+/*! \brief Lua only aligns userdata to 8, so they are allocated 15 bytes bigger & aligned here */
+static NativeVector* AlignVector( void* ud )
+{
+	return (NativeVector*)( ( (uintptr_t)ud + 15 ) & ~(uintptr_t)15 );
+}
+
+NativeVector* ToNativeVector( lua_State* L, int idx )
+{
+	void* ud = luaL_testudata( L, idx, NATIVE_VECTOR_METATABLE );
+	return ud ? AlignVector( ud ) : nullptr;
+}
+
+static NativeVector& CheckVector( lua_State* L, int idx )
+{
+	return *AlignVector( luaL_checkudata( L, idx, NATIVE_VECTOR_METATABLE ) );
+}
+
+/*! \brief The other vector of a binary operation, must have as many components as #v */
+static NativeVector& CheckMatchingVector( lua_State* L, int idx, const NativeVector& v )
+{
+	NativeVector& other = CheckVector( L, idx );
+	if ( other.m_numComponents != v.m_numComponents )
+	{
+		luaL_error( L, "vectors don't match, Vec%d and Vec%d", v.m_numComponents, other.m_numComponents );
+	}
+	return other;
+}
+
+/*! \brief The components from #firstIdx on the stack, missing ones are 0 */
+static void ReadComponents( lua_State* L, int firstIdx, NativeVector& v )
+{
+	for ( int i = 0; i < v.m_numComponents; i++ )
+	{
+		v.m_v[i] = (float)luaL_optnumber( L, firstIdx + i, 0 );
+	}
+}
+
+NativeVector* PushNativeVector( lua_State* L, int numComponents, const float* v )
+{
+	NativeVector* vec = AlignVector( lua_newuserdata( L, sizeof( NativeVector ) + 15 ) );
+	memset( vec->m_v, 0, sizeof( vec->m_v ) );
+	if ( v )
+	{
+		memcpy( vec->m_v, v, sizeof( float ) * numComponents );
+	}
+	vec->m_numComponents = numComponents;
+	luaL_setmetatable( L, NATIVE_VECTOR_METATABLE );
+	return vec;
+}
+
+static int NewVector( lua_State* L )
+{
+	NativeVector& v = *PushNativeVector( L, (int)lua_tointeger( L, lua_upvalueindex( 1 ) ) );
+	ReadComponents( L, 1, v );
+	return 1;
+}
+
+/*! \brief Vec3.temp( x, y, z ), the next vector from the state's scratch ring */
+static int TempVector( lua_State* L )
+{
+	const int numComponents = (int)lua_tointeger( L, lua_upvalueindex( 1 ) );
+	const int ringIdx = lua_upvalueindex( 2 );
+	lua_rawgeti( L, ringIdx, 0 );
+	lua_Integer next = lua_tointeger( L, -1 ) % NUM_SCRATCH_VECTORS + 1;
+	lua_pop( L, 1 );
+	lua_pushinteger( L, next );
+	lua_rawseti( L, ringIdx, 0 );
+
+	if ( lua_rawgeti( L, ringIdx, next ) == LUA_TNIL )
+	{
+		lua_pop( L, 1 );
+		PushNativeVector( L, numComponents );
+		lua_pushvalue( L, -1 );
+		lua_rawseti( L, ringIdx, next );
+	}
+	ReadComponents( L, 1, *AlignVector( lua_touserdata( L, -1 ) ) );
+	return 1;
+}
+
+static int VectorAdd( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	NativeVector& b = CheckMatchingVector( L, 2, a );
+	NativeVector* r = PushNativeVector( L, a.m_numComponents );
+	VectorOps::Add( r->m_v, a.m_v, b.m_v );
+	return 1;
+}
+
+static int VectorSub( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	NativeVector& b = CheckMatchingVector( L, 2, a );
+	NativeVector* r = PushNativeVector( L, a.m_numComponents );
+	VectorOps::Sub( r->m_v, a.m_v, b.m_v );
+	return 1;
+}
+
+/*! \brief vector * vector (per component), vector * number or number * vector */
+static int VectorMul( lua_State* L )
+{
+	if ( lua_isnumber( L, 1 ) )
+	{
+		lua_rotate( L, 1, 1 );		//number * vector, swap them
+	}
+	NativeVector& a = CheckVector( L, 1 );
+	if ( lua_type( L, 2 ) == LUA_TNUMBER )
+	{
+		float s = (float)lua_tonumber( L, 2 );
+		NativeVector* r = PushNativeVector( L, a.m_numComponents );
+		VectorOps::Scale( r->m_v, a.m_v, s );
+		return 1;
+	}
+	NativeVector& b = CheckMatchingVector( L, 2, a );
+	NativeVector* r = PushNativeVector( L, a.m_numComponents );
+	VectorOps::Mul( r->m_v, a.m_v, b.m_v );
+	return 1;
+}
+
+static int VectorUnm( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	NativeVector* r = PushNativeVector( L, a.m_numComponents );
+	VectorOps::Negate( r->m_v, a.m_v );
+	return 1;
+}
+
+static int VectorEq( lua_State* L )
+{
+	NativeVector* a = ToNativeVector( L, 1 );
+	NativeVector* b = ToNativeVector( L, 2 );
+	lua_pushboolean( L, a && b && a->m_numComponents == b->m_numComponents && VectorOps::Equal( a->m_v, b->m_v ) );
+	return 1;
+}
+
+static int VectorAddInPlace( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	VectorOps::Add( a.m_v, a.m_v, CheckMatchingVector( L, 2, a ).m_v );
+	lua_settop( L, 1 );
+	return 1;	//the vector, so calls can be chained
+}
+
+static int VectorSubInPlace( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	VectorOps::Sub( a.m_v, a.m_v, CheckMatchingVector( L, 2, a ).m_v );
+	lua_settop( L, 1 );
+	return 1;
+}
+
+static int VectorMulInPlace( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	if ( lua_type( L, 2 ) == LUA_TNUMBER )
+	{
+		VectorOps::Scale( a.m_v, a.m_v, (float)lua_tonumber( L, 2 ) );
+	}
+	else
+	{
+		VectorOps::Mul( a.m_v, a.m_v, CheckMatchingVector( L, 2, a ).m_v );
+	}
+	lua_settop( L, 1 );
+	return 1;
+}
+
+static int VectorSet( lua_State* L )
+{
+	ReadComponents( L, 2, CheckVector( L, 1 ) );
+	lua_settop( L, 1 );
+	return 1;
+}
+
+static int VectorCopy( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	memcpy( a.m_v, CheckMatchingVector( L, 2, a ).m_v, sizeof( a.m_v ) );
+	lua_settop( L, 1 );
+	return 1;
+}
+
+static int VectorDot( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	lua_pushnumber( L, VectorOps::Dot( a.m_v, CheckMatchingVector( L, 2, a ).m_v ) );
+	return 1;
+}
+
+static int VectorLength( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	lua_pushnumber( L, std::sqrt( VectorOps::Dot( a.m_v, a.m_v ) ) );
+	return 1;
+}
+
+static int VectorUnpack( lua_State* L )
+{
+	NativeVector& a = CheckVector( L, 1 );
+	for ( int i = 0; i < a.m_numComponents; i++ )
+	{
+		lua_pushnumber( L, a.m_v[i] );
+	}
+	return a.m_numComponents;
+}
+
+/*! \return 0 to 3 for "x" to "w", -1 for anything else */
+static int ComponentIndex( lua_State* L, int keyIdx )
+{
+	size_t length = 0;
+	const char* key = lua_tolstring( L, keyIdx, &length );
+	if ( key == nullptr || length != 1 )
+	{
+		return -1;
+	}
+	switch ( key[0] )
+	{
+	case 'x': return 0;
+	case 'y': return 1;
+	case 'z': return 2;
+	case 'w': return 3;
+	default: return -1;
+	}
+}
+
+static int VectorIndex( lua_State* L )
+{
+	// 1 - vector, 2 - key
+	NativeVector& v = *AlignVector( lua_touserdata( L, 1 ) );
+	if ( lua_type( L, 2 ) == LUA_TSTRING )
+	{
+		int component = ComponentIndex( L, 2 );
+		if ( component >= 0 && component < v.m_numComponents )
+		{
+			lua_pushnumber( L, v.m_v[component] );
+			return 1;
+		}
+	}
+
+	//a method name
+	lua_pushvalue( L, 2 );
+	lua_rawget( L, lua_upvalueindex( 1 ) );
+	return 1;
+}
+
+static int VectorNewIndex( lua_State* L )
+{
+	// 1 - vector, 2 - key, 3 - value
+	NativeVector& v = *AlignVector( lua_touserdata( L, 1 ) );
+	int component = lua_type( L, 2 ) == LUA_TSTRING ? ComponentIndex( L, 2 ) : -1;
+	if ( component < 0 || component >= v.m_numComponents )
+	{
+		return luaL_error( L, "Vec%d has no component '%s'", v.m_numComponents, luaL_tolstring( L, 2, nullptr ) );
+	}
+	v.m_v[component] = (float)luaL_checknumber( L, 3 );
+	return 0;
+}
+
+static int VectorToString( lua_State* L )
+{
+	NativeVector& v = CheckVector( L, 1 );
+	char text[128];
+	int length = snprintf( text, sizeof( text ), "Vec%d(", v.m_numComponents );
+	for ( int i = 0; i < v.m_numComponents; i++ )
+	{
+		length += snprintf( text + length, sizeof( text ) - length, i == 0 ? "%g" : ", %g", v.m_v[i] );
+	}
+	snprintf( text + length, sizeof( text ) - length, ")" );
+	lua_pushstring( L, text );
+	return 1;
+}
+
+void OpenNativeVectors( lua_State* L )
+{
+	static const luaL_Reg METHODS[] =
+	{
+		{ "addInPlace", VectorAddInPlace },
+		{ "subInPlace", VectorSubInPlace },
+		{ "mulInPlace", VectorMulInPlace },
+		{ "set", VectorSet },
+		{ "copy", VectorCopy },
+		{ "dot", VectorDot },
+		{ "length", VectorLength },
+		{ "unpack", VectorUnpack },
+		{ nullptr, nullptr }
+	};
+
+	static const luaL_Reg METAMETHODS[] =
+	{
+		{ "__newindex", VectorNewIndex },
+		{ "__add", VectorAdd },
+		{ "__sub", VectorSub },
+		{ "__mul", VectorMul },
+		{ "__unm", VectorUnm },
+		{ "__eq", VectorEq },
+		{ "__tostring", VectorToString },
+		{ nullptr, nullptr }
+	};
+
+	luaL_newmetatable( L, NATIVE_VECTOR_METATABLE );
+	luaL_setfuncs( L, METAMETHODS, 0 );
+	luaL_newlib( L, METHODS );
+	lua_pushcclosure( L, VectorIndex, 1 );		//the methods are __index's upvalue
+	lua_setfield( L, -2, "__index" );
+	lua_pop( L, 1 );
+
+	static const char* const NAMES[] = { "Vec2", "Vec3", "Vec4" };
+	for ( int numComponents = 2; numComponents <= 4; numComponents++ )
+	{
+		lua_createtable( L, 0, 2 );
+		lua_pushinteger( L, numComponents );
+		lua_pushcclosure( L, NewVector, 1 );
+		lua_setfield( L, -2, "new" );
+		lua_pushinteger( L, numComponents );
+		lua_createtable( L, NUM_SCRATCH_VECTORS, 0 );	//the scratch ring, [0] is the last one used
+		lua_pushcclosure( L, TempVector, 2 );
+		lua_setfield( L, -2, "temp" );
+		lua_setglobal( L, NAMES[numComponents - 2] );
+	}
+}
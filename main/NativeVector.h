@@ -0,0 +1,28 @@
+#pragma once
+#include "lua.hpp"
+
+/*! \brief A 2, 3 or 4 component float vector as a userdata value, the math done with SSE.
+*	From Lua:
+*		local a = Vec3.new( 1, 2, 3 )
+*		local c = a + b; c = a - b; c = a * b; c = a * 2; c = -a; a == b; a.x = 5
+*		a:dot( b ) a:length() a:unpack() a:set( x, y, z ) a:copy( b )
+*		a:addInPlace( b ) a:subInPlace( b ) a:mulInPlace( b or n )	-- change a, no allocation
+*		local t = Vec3.temp()	-- a scratch vector, reused after NUM_SCRATCH_VECTORS more temps
+*	The operators make a new userdata, the in place methods & temps let hot loops avoid that. */
+struct alignas(16) NativeVector
+{
+	float m_v[4];			//the unused components are kept at 0
+	int m_numComponents;
+};
+
+constexpr const char* NATIVE_VECTOR_METATABLE = "NativeVector_MT_";
+constexpr int NUM_SCRATCH_VECTORS = 32;		//per number of components
+
+/*! \brief Creates the global "Vec2", "Vec3" & "Vec4" tables & the vector metatable, call once per state */
+void OpenNativeVectors( lua_State* L );
+
+/*! \brief Pushes a new vector of #numComponents (2 to 4), set from #v, or zeroed if #v is nullptr */
+NativeVector* PushNativeVector( lua_State* L, int numComponents, const float* v = nullptr );
+
+/*! \return the vector at #idx, or nullptr if it isn't one */
+NativeVector* ToNativeVector( lua_State* L, int idx );
@@ -0,0 +1,149 @@
+#include "PerfCounters.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> g_perfCountersEnabled( false );
+
+static uint64_t WallNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+#if defined(__linux__)
+
+/*! \brief A perf event group counting the thread that opened it */
+class PerfCounterGroup
+{
+public:
+	static constexpr int NUM_COUNTERS = 4;
+
+	PerfCounterGroup()
+	{
+		static const uint64_t COUNTERS[NUM_COUNTERS] =
+		{
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES,
+			PERF_COUNT_HW_BRANCH_MISSES,
+		};
+
+		for ( int i = 0; i < NUM_COUNTERS; i++ )
+		{
+			m_fds[i] = -1;
+		}
+		for ( int i = 0; i < NUM_COUNTERS; i++ )
+		{
+			perf_event_attr attr;
+			memset( &attr, 0, sizeof( attr ) );
+			attr.size = sizeof( attr );
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = COUNTERS[i];
+			attr.read_format = PERF_FORMAT_GROUP;
+			attr.exclude_kernel = 1;		//allowed with perf_event_paranoid 2
+			attr.exclude_hv = 1;
+			attr.disabled = i == 0 ? 1 : 0;	//the whole group starts when the leader is enabled
+
+			m_fds[i] = (int)syscall( SYS_perf_event_open, &attr, 0 /*this thread*/, -1 /*any cpu*/, i == 0 ? -1 : m_fds[0], 0 );
+			if ( m_fds[i] == -1 )
+			{
+				static std::atomic<bool> s_reported( false );
+				if ( s_reported.exchange( true ) == false )
+				{
+					printf( "hardware performance counters unavailable (%s), timing with the clock only\n", strerror( errno ) );
+				}
+				Close();
+				return;
+			}
+		}
+		ioctl( m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+		ioctl( m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+	}
+
+	~PerfCounterGroup()
+	{
+		Close();
+	}
+
+	bool IsOpen() const
+	{
+		return m_fds[0] != -1;
+	}
+
+	void Read( PerfSample& sample )
+	{
+		struct
+		{
+			uint64_t numCounters;
+			uint64_t values[NUM_COUNTERS];
+		} group;
+		if ( IsOpen() == false || read( m_fds[0], &group, sizeof( group ) ) != (ssize_t)sizeof( group ) )
+		{
+			return;
+		}
+		sample.cycles = group.values[0];
+		sample.instructions = group.values[1];
+		sample.cacheMisses = group.values[2];
+		sample.branchMisses = group.values[3];
+		sample.hasHardwareCounters = true;
+	}
+
+private:
+	void Close()
+	{
+		for ( int i = NUM_COUNTERS - 1; i >= 0; i-- )
+		{
+			if ( m_fds[i] != -1 )
+			{
+				close( m_fds[i] );
+				m_fds[i] = -1;
+			}
+		}
+	}
+
+	int m_fds[NUM_COUNTERS];
+};
+
+static PerfCounterGroup& ThisThreadCounters()
+{
+	thread_local PerfCounterGroup counters;
+	return counters;
+}
+
+PerfSample ReadPerfCounters()
+{
+	PerfSample sample;
+	ThisThreadCounters().Read( sample );
+	sample.wallNs = WallNs();
+	return sample;
+}
+
+bool HasHardwareCounters()
+{
+	return ThisThreadCounters().IsOpen();
+}
+
+#else
+
+PerfSample ReadPerfCounters()
+{
+	PerfSample sample;
+	sample.wallNs = WallNs();
+	return sample;
+}
+
+bool HasHardwareCounters()
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+/*! \brief Cumulative counts for the calling thread, subtract two to get the counts between them.
+*	Without hardware counters only wallNs is filled in. */
+struct PerfSample
+{
+	uint64_t wallNs = 0;
+	uint64_t cycles = 0;
+	uint64_t instructions = 0;
+	uint64_t cacheMisses = 0;
+	uint64_t branchMisses = 0;
+	bool hasHardwareCounters = false;
+};
+
+inline PerfSample operator-( const PerfSample& end, const PerfSample& start )
+{
+	PerfSample delta;
+	delta.wallNs = end.wallNs - start.wallNs;
+	delta.cycles = end.cycles - start.cycles;
+	delta.instructions = end.instructions - start.instructions;
+	delta.cacheMisses = end.cacheMisses - start.cacheMisses;
+	delta.branchMisses = end.branchMisses - start.branchMisses;
+	delta.hasHardwareCounters = end.hasHardwareCounters && start.hasHardwareCounters;
+	return delta;
+}
+
+extern std::atomic<bool> g_perfCountersEnabled;
+
+/*! \brief When on, ExecuteScript & CallScriptFunction record their counts with RecordScriptRun */
+inline void SetPerfCountersEnabled( bool enabled )
+{
+	g_perfCountersEnabled.store( enabled, std::memory_order_relaxed );
+}
+
+inline bool PerfCountersEnabled()
+{
+	return g_perfCountersEnabled.load( std::memory_order_relaxed );
+}
+
+/*! \brief Reads this thread's counters. The first call on a thread opens a Linux perf_event_open group
+*	(cycles, instructions, cache misses, branch misses, user space only). If the kernel or container
+*	doesn't allow it, or this isn't Linux, it falls back to the clock alone. */
+PerfSample ReadPerfCounters();
+
+/*! \return true if this thread got its hardware counters */
+bool HasHardwareCounters();
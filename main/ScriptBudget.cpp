@@ -0,0 +1,144 @@
+#include "ScriptBudget.h"
+#include <chrono>
+
+using BudgetClock = std::chrono::steady_clock;
+
+//address used as the registry key of the innermost running budget, the registry is shared by every thread
+//of the state, so coroutines the script makes (which inherit the hook) are held to the same budget
+static const char BUDGET_KEY = 0;
+
+/*! \brief The budget of a running script */
+struct BudgetState
+{
+	lua_State* thread;		//the thread the budget was given to
+	BudgetState* previous;	//the budget this one is nested in, restored when it ends
+	long long maxInstructions;
+	long long instructionsRun;
+	int checkInterval;
+	bool hasDeadline;
+	BudgetClock::time_point deadline;
+	bool yieldWhenExceeded;
+	bool exceeded;
+};
+
+static void BudgetHook( lua_State* L, lua_Debug* /*ar*/ )
+{
+	lua_rawgetp( L, LUA_REGISTRYINDEX, &BUDGET_KEY );
+	BudgetState* state = (BudgetState*)lua_touserdata( L, -1 );
+	lua_pop( L, 1 );
+	if ( state == nullptr )
+	{
+		return;
+	}
+
+	state->instructionsRun += state->checkInterval;
+	if ( state->exceeded == false )
+	{
+		state->exceeded = ( state->maxInstructions > 0 && state->instructionsRun >= state->maxInstructions ) ||
+			( state->hasDeadline && BudgetClock::now() >= state->deadline );
+	}
+
+	if ( state->exceeded )
+	{
+		//count hooks are allowed to yield, but not across a C call (e.g. in a metamethod), and yielding a
+		//coroutine the script made would just return to the script
+		if ( state->yieldWhenExceeded && L == state->thread && lua_isyieldable( L ) )
+		{
+			lua_yield( L, 0 );
+		}
+		else
+		{
+			//raise again on every instruction from here on, so a pcall in the script can't swallow the abort
+			lua_sethook( L, BudgetHook, LUA_MASKCOUNT, 1 );
+			luaL_error( L, "script budget exceeded" );
+		}
+	}
+}
+
+/*! \brief Installs the budget hook on #L, \return false if the budget is unlimited & no hook is needed */
+static bool BeginBudget( lua_State* L, const ScriptBudget& budget, bool yieldWhenExceeded, BudgetState& state )
+{
+	if ( budget.maxInstructions <= 0 && budget.maxMilliseconds <= 0 )
+	{
+		return false;
+	}
+
+	state.maxInstructions = budget.maxInstructions;
+	state.instructionsRun = 0;
+	state.checkInterval = budget.checkInterval > 0 ? budget.checkInterval : 1000;
+	if ( state.maxInstructions > 0 && state.maxInstructions < state.checkInterval )
+	{
+		state.checkInterval = (int)state.maxInstructions;
+	}
+	state.hasDeadline = budget.maxMilliseconds > 0;
+	state.deadline = BudgetClock::now() +
+		std::chrono::duration_cast<BudgetClock::duration>( std::chrono::duration<double, std::milli>( budget.maxMilliseconds ) );
+	state.yieldWhenExceeded = yieldWhenExceeded;
+	state.exceeded = false;
+	state.thread = L;
+
+	lua_rawgetp( L, LUA_REGISTRYINDEX, &BUDGET_KEY );
+	state.previous = (BudgetState*)lua_touserdata( L, -1 );
+	lua_pop( L, 1 );
+	lua_pushlightuserdata( L, &state );
+	lua_rawsetp( L, LUA_REGISTRYINDEX, &BUDGET_KEY );
+	lua_sethook( L, BudgetHook, LUA_MASKCOUNT, state.checkInterval );
+	return true;
+}
+
+static void EndBudget( lua_State* L, const BudgetState& state, lua_Hook previousHook, int previousMask, int previousCount )
+{
+	lua_sethook( L, previousHook, previousMask, previousCount );
+	if ( state.previous )
+	{
+		lua_pushlightuserdata( L, state.previous );
+	}
+	else
+	{
+		lua_pushnil( L );
+	}
+	lua_rawsetp( L, LUA_REGISTRYINDEX, &BUDGET_KEY );
+}
+
+int ExecuteScriptBudgeted( lua_State* L, const ScriptBudget& budget )
+{
+	lua_Hook previousHook = lua_gethook( L );
+	int previousMask = lua_gethookmask( L );
+	int previousCount = lua_gethookcount( L );
+
+	BudgetState state;
+	if ( BeginBudget( L, budget, false, state ) == false )
+	{
+		return lua_pcall( L, 0, LUA_MULTRET, 0 );
+	}
+
+	int result = lua_pcall( L, 0, LUA_MULTRET, 0 );
+	EndBudget( L, state, previousHook, previousMask, previousCount );
+	if ( result != LUA_OK && state.exceeded )
+	{
+		result = SCRIPT_ERRBUDGET;
+	}
+	return result;
+}
+
+int ResumeScriptBudgeted( lua_State* co, lua_State* from, int numArgs, const ScriptBudget& budget, bool* budgetExceeded )
+{
+	lua_Hook previousHook = lua_gethook( co );
+	int previousMask = lua_gethookmask( co );
+	int previousCount = lua_gethookcount( co );
+
+	BudgetState state;
+	state.exceeded = false;
+	bool hooked = BeginBudget( co, budget, true, state );
+	int result = lua_resume( co, from, numArgs );
+	if ( hooked )
+	{
+		EndBudget( co, state, previousHook, previousMask, previousCount );
+	}
+
+	if ( budgetExceeded )
+	{
+		*budgetExceeded = state.exceeded;
+	}
+	return result;
+}
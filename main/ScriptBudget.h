@@ -0,0 +1,29 @@
+#pragma once
+#include "lua.hpp"
+
+/*! \brief How long a script may run for, see ExecuteScriptBudgeted & ResumeScriptBudgeted.
+*	A limit of 0 means no limit, with no limits at all no hook is installed. */
+struct ScriptBudget
+{
+	long long maxInstructions = 0;
+	double maxMilliseconds = 0;
+	int checkInterval = 1000;		//number of VM instructions between each check of the budget
+};
+
+/*! \brief Returned by ExecuteScriptBudgeted when the script ran out of budget & was aborted,
+*	the error message "script budget exceeded" is left on the stack. */
+constexpr int SCRIPT_ERRBUDGET = 100;
+
+/*! \brief ExecuteScript, but the script is aborted if it runs for longer than #budget allows.
+*	Coroutines the script makes count against the same budget, and once it's exceeded the error is raised
+*	again on every instruction, so the script can't pcall its way past it.
+*	\return LUA_OK, a Lua error code or SCRIPT_ERRBUDGET */
+int ExecuteScriptBudgeted( lua_State* L, const ScriptBudget& budget );
+
+/*! \brief lua_resume's #co for at most #budget, when the budget runs out the coroutine yields
+*	so a long job can be time sliced by resuming it again on the next tick.
+*	Where #co can't yield (inside a metamethod or other C call, or in a coroutine of its own) it's aborted
+*	with the "script budget exceeded" error instead, as ExecuteScriptBudgeted does.
+*	\param budgetExceeded optional, set to true if the coroutine yielded or was aborted because it ran out of budget
+*	\return the lua_resume result, LUA_YIELD if it ran out of budget & could yield */
+int ResumeScriptBudgeted( lua_State* co, lua_State* from, int numArgs, const ScriptBudget& budget, bool* budgetExceeded = nullptr );
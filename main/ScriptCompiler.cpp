@@ -0,0 +1,115 @@
+#include "ScriptCompiler.h"
+#include "ArenaAllocator.h"
+#include <cstdio>
+#include <string.h>
+#include <assert.h>
+
+static int WriteBytecode( lua_State*, const void* p, size_t sz, void* ud )
+{
+	std::vector<char>& bytecode = *static_cast<std::vector<char>*>( ud );
+	const char* bytes = static_cast<const char*>( p );
+	bytecode.insert( bytecode.end(), bytes, bytes + sz );
+	return 0;
+}
+
+/*! \brief Worker loop, claims the next uncompiled script until there are none left */
+static void CompileWorker( const std::vector<ScriptSource>& scripts, std::vector<CompiledScript>& results, std::atomic<int>& nextScript )
+{
+	//every worker has its own memory pool & Lua state, nothing here is shared with other threads
+	constexpr int POOL_SIZE = 1024 * 256;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = lua_newstate( ArenaAllocator::l_alloc, &pool );
+
+	const int numScripts = (int)scripts.size();
+	for ( int i = nextScript++; i < numScripts; i = nextScript++ )
+	{
+		const ScriptSource& script = scripts[i];
+		CompiledScript& result = results[i];
+		result.name = script.name;
+		if ( luaL_loadbufferx( L, script.source, strlen( script.source ), script.name, "t" ) == LUA_OK )
+		{
+			lua_dump( L, WriteBytecode, &result.bytecode, 0 );
+		}
+		else
+		{
+			result.error = lua_tostring( L, -1 );
+		}
+		lua_pop( L, 1 );
+	}
+
+	lua_close( L );
+}
+
+std::vector<CompiledScript> CompileScripts( const std::vector<ScriptSource>& scripts, int numThreads )
+{
+	if ( numThreads <= 0 )
+	{
+		numThreads = (int)std::thread::hardware_concurrency();
+	}
+	if ( numThreads > (int)scripts.size() )
+	{
+		numThreads = (int)scripts.size();
+	}
+
+	std::vector<CompiledScript> results( scripts.size() );
+	std::atomic<int> nextScript( 0 );
+
+	//the calling thread is worker 0
+	std::vector<std::thread> workers;
+	for ( int i = 1; i < numThreads; i++ )
+	{
+		workers.emplace_back( CompileWorker, std::cref( scripts ), std::ref( results ), std::ref( nextScript ) );
+	}
+	CompileWorker( scripts, results, nextScript );
+	for ( auto& worker : workers )
+	{
+		worker.join();
+	}
+
+	return results;
+}
+
+int LoadCompiledScript( lua_State* L, const CompiledScript& script )
+{
+	if ( script.error.empty() == false )
+	{
+		lua_pushstring( L, script.error.c_str() );
+		return LUA_ERRSYNTAX;
+	}
+	return luaL_loadbufferx( L, script.bytecode.data(), script.bytecode.size(), script.name.c_str(), "b" );
+}
+
+ScriptCompileJob::ScriptCompileJob( const std::vector<ScriptSource>& scripts, int numThreads ) :
+	m_scripts( scripts ),
+	m_finished( false )
+{
+	m_thread = std::thread( [this, numThreads]()
+	{
+		m_results = CompileScripts( m_scripts, numThreads );
+		m_finished = true;
+	} );
+}
+
+ScriptCompileJob::~ScriptCompileJob()
+{
+	if ( m_thread.joinable() )
+	{
+		m_thread.join();
+	}
+}
+
+bool ScriptCompileJob::IsFinished() const
+{
+	return m_finished;
+}
+
+std::vector<CompiledScript>& ScriptCompileJob::Wait()
+{
+	if ( m_thread.joinable() )
+	{
+		m_thread.join();
+	}
+	assert( m_finished );
+	return m_results;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "lua.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*! \brief A script to be compiled. #name and #source are not copied and must outlive the compile. */
+struct ScriptSource
+{
+	const char* name;
+	const char* source;
+};
+
+/*! \brief The Lua bytecode produced by compiling a ScriptSource */
+struct CompiledScript
+{
+	std::string name;
+	std::vector<char> bytecode;
+	std::string error;		//empty if the script compiled
+};
+
+/*! \brief Compiles #scripts to Lua bytecode on a pool of worker threads.
+*	Each worker uses its own lua_State and ArenaAllocator, so no Lua state is shared between threads.
+*	Blocks until every script is compiled, results are in the same order as #scripts.
+*	\param numThreads number of workers, 0 uses std::thread::hardware_concurrency() */
+std::vector<CompiledScript> CompileScripts( const std::vector<ScriptSource>& scripts, int numThreads = 0 );
+
+/*! \brief Loads bytecode made by CompileScripts into #L, leaves the chunk on the stack just like LoadScript.
+*	\return LUA_OK or the lua_load error code (a failed compile is returned as LUA_ERRSYNTAX) */
+int LoadCompiledScript( lua_State* L, const CompiledScript& script );
+
+/*! \brief Compiles a set of scripts in the background.
+*	Poll IsFinished() each tick and take the results with Wait() once it returns true,
+*	or call Wait() straight away to block. */
+class ScriptCompileJob
+{
+public:
+	ScriptCompileJob( const std::vector<ScriptSource>& scripts, int numThreads = 0 );
+	~ScriptCompileJob();
+
+	ScriptCompileJob( const ScriptCompileJob& ) = delete;
+	ScriptCompileJob& operator=( const ScriptCompileJob& ) = delete;
+
+	bool IsFinished() const;
+
+	/*! \brief Blocks until the compile has finished */
+	std::vector<CompiledScript>& Wait();
+
+private:
+	std::vector<ScriptSource> m_scripts;
+	std::vector<CompiledScript> m_results;
+	std::atomic<bool> m_finished;
+	std::thread m_thread;
+};
@@ -0,0 +1,218 @@
+#include "ScriptExecutor.h"
+#include "ArenaAllocator.h"
+#include "AutomatedBinding.h"
+#include "ScriptTrace.h"
+#include <cstdio>
+#include <assert.h>
+
+ScriptExecutor::ScriptExecutor( int numThreads, size_t poolSizeBytes ) :
+	m_stop( false ),
+	m_numQueued( 0 ),
+	m_numPending( 0 ),
+	m_numJobsRun( 0 ),
+	m_numJobsStolen( 0 )
+{
+	if ( numThreads <= 0 )
+	{
+		numThreads = (int)std::thread::hardware_concurrency();
+		if ( numThreads <= 0 )
+		{
+			numThreads = 1;
+		}
+	}
+
+	//create every worker before starting any, the workers look at each other's queues
+	for ( int i = 0; i < numThreads; i++ )
+	{
+		std::unique_ptr<Worker> worker( new Worker() );
+		worker->m_memory.resize( poolSizeBytes );
+		worker->m_allocator.reset( new ArenaAllocator( worker->m_memory.data(), &worker->m_memory[poolSizeBytes - 1] ) );
+		m_workers.push_back( std::move( worker ) );
+	}
+	for ( int i = 0; i < numThreads; i++ )
+	{
+		m_workers[i]->m_thread = std::thread( &ScriptExecutor::WorkerLoop, this, i );
+	}
+}
+
+ScriptExecutor::~ScriptExecutor()
+{
+	WaitIdle();
+	{
+		std::lock_guard<std::mutex> lock( m_sleepMutex );
+		m_stop = true;
+	}
+	m_workAvailable.notify_all();
+	for ( auto& worker : m_workers )
+	{
+		worker->m_thread.join();
+		for ( auto& state : worker->m_states )
+		{
+			CloseScript( state.second );
+		}
+	}
+}
+
+int ScriptExecutor::AddScript( const char* source )
+{
+	std::lock_guard<std::mutex> lock( m_scriptsMutex );
+	m_scripts.push_back( source );
+	return (int)m_scripts.size() - 1;
+}
+
+void ScriptExecutor::Submit( ScriptJob job )
+{
+	//the script's home worker
+	Worker& worker = *m_workers[job.scriptId % m_workers.size()];
+	m_numPending++;
+	{
+		std::lock_guard<std::mutex> lock( worker.m_queueMutex );
+		worker.m_queue.push_back( std::move( job ) );
+	}
+	{
+		std::lock_guard<std::mutex> lock( m_sleepMutex );
+		m_numQueued++;
+	}
+	m_workAvailable.notify_one();
+}
+
+void ScriptExecutor::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock( m_sleepMutex );
+	m_idle.wait( lock, [this]() { return m_numPending == 0; } );
+}
+
+void ScriptExecutor::WorkerLoop( int workerIdx )
+{
+	Worker& worker = *m_workers[workerIdx];
+	char threadName[32];
+	snprintf( threadName, sizeof( threadName ), "script worker %d", workerIdx );
+	SetTraceThreadName( threadName );
+	while ( true )
+	{
+		ScriptJob job;
+		if ( PopJob( worker, job ) || StealJob( workerIdx, job ) )
+		{
+			m_numQueued--;
+			RunJob( worker, job );
+			m_numJobsRun++;
+			if ( --m_numPending == 0 )
+			{
+				std::lock_guard<std::mutex> lock( m_sleepMutex );
+				m_idle.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( m_sleepMutex );
+		if ( m_stop )
+		{
+			return;
+		}
+		m_workAvailable.wait( lock, [this]() { return m_stop || m_numQueued > 0; } );
+	}
+}
+
+bool ScriptExecutor::PopJob( Worker& worker, ScriptJob& job )
+{
+	std::lock_guard<std::mutex> lock( worker.m_queueMutex );
+	if ( worker.m_queue.empty() )
+	{
+		return false;
+	}
+	job = std::move( worker.m_queue.front() );
+	worker.m_queue.pop_front();
+	return true;
+}
+
+bool ScriptExecutor::StealJob( int thiefIdx, ScriptJob& job )
+{
+	Worker& thief = *m_workers[thiefIdx];
+	const int numWorkers = (int)m_workers.size();
+	for ( int i = 1; i < numWorkers; i++ )
+	{
+		Worker& victim = *m_workers[( thiefIdx + i ) % numWorkers];
+		std::lock_guard<std::mutex> lock( victim.m_queueMutex );
+		if ( victim.m_queue.empty() )
+		{
+			continue;
+		}
+
+		//take from the back, the owner works from the front. Prefer a job we already have a hot state for.
+		auto stolen = victim.m_queue.end() - 1;
+		for ( auto it = victim.m_queue.rbegin(); it != victim.m_queue.rend(); ++it )
+		{
+			if ( thief.m_states.count( it->scriptId ) )
+			{
+				stolen = it.base() - 1;
+				break;
+			}
+		}
+		job = std::move( *stolen );
+		victim.m_queue.erase( stolen );
+		m_numJobsStolen++;
+		return true;
+	}
+	return false;
+}
+
+lua_State* ScriptExecutor::GetState( Worker& worker, int scriptId )
+{
+	auto it = worker.m_states.find( scriptId );
+	if ( it != worker.m_states.end() )
+	{
+		return it->second;
+	}
+
+	std::string source;
+	{
+		std::lock_guard<std::mutex> lock( m_scriptsMutex );
+		assert( scriptId >= 0 && scriptId < (int)m_scripts.size() );
+		source = m_scripts[scriptId];
+	}
+
+	lua_State* L = CreateScript( *worker.m_allocator );
+	if ( LoadScript( L, source.c_str() ) != LUA_OK || ExecuteScript( L ) != LUA_OK )
+	{
+		printf( "Error loading script %d: %s\n", scriptId, lua_tostring( L, -1 ) );
+	}
+	lua_settop( L, 0 );
+	worker.m_states[scriptId] = L;
+	return L;
+}
+
+/*! \brief Pushes the job's args & calls its function (stack: function, lightuserdata ScriptJob*).
+*	Run with lua_pcall, as ToLua raises a Lua error for an arg it can't marshal. */
+static int CallJob( lua_State* L )
+{
+	ScriptJob* job = (ScriptJob*)lua_touserdata( L, 2 );
+	lua_settop( L, 1 );
+	int numArgs = 0;
+	for ( auto& arg : job->args )
+	{
+		numArgs += ToLua( L, arg );
+	}
+	lua_call( L, numArgs, 0 );
+	return 0;
+}
+
+void ScriptExecutor::RunJob( Worker& worker, ScriptJob& job )
+{
+	ScopedTraceSpan span( job.funcName.c_str(), job.funcName.size(), "script" );
+	lua_State* L = GetState( worker, job.scriptId );
+	if ( lua_getglobal( L, job.funcName.c_str() ) != LUA_TFUNCTION )
+	{
+		printf( "unknown script function '%s'\n", job.funcName.c_str() );
+		lua_settop( L, 0 );
+		return;
+	}
+
+	lua_pushcfunction( L, CallJob );
+	lua_insert( L, -2 );
+	lua_pushlightuserdata( L, &job );
+	if ( lua_pcall( L, 2, 0, 0 ) != LUA_OK )
+	{
+		printf( "unable to call script function '%s', '%s'\n", job.funcName.c_str(), lua_tostring( L, -1 ) );
+	}
+	lua_settop( L, 0 );
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "lua.hpp"
+#include <rttr/type>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct ArenaAllocator;
+
+/*! \brief Run function #funcName of script #scriptId with #args */
+struct ScriptJob
+{
+	int scriptId;
+	std::string funcName;
+	std::vector<rttr::variant> args;
+};
+
+/*! \brief Runs ScriptJobs on a pool of worker threads.
+*	- Every worker has its own ArenaAllocator & its own lua_State for each script it has run,
+*	  states are never shared between threads.
+*	- Each script has a home worker that its jobs are queued on, so they run against a state that is already hot.
+*	- An idle worker steals from the back of another worker's queue, preferring jobs for scripts it already has a state for. */
+class ScriptExecutor
+{
+public:
+	/*! \param numThreads number of workers, 0 uses std::thread::hardware_concurrency()
+	*	\param poolSizeBytes size of each worker's memory pool */
+	ScriptExecutor( int numThreads = 0, size_t poolSizeBytes = 1024 * 256 );
+	~ScriptExecutor();
+
+	ScriptExecutor( const ScriptExecutor& ) = delete;
+	ScriptExecutor& operator=( const ScriptExecutor& ) = delete;
+
+	/*! \brief Adds a script that jobs can be run against, it is loaded on a worker the first time that worker needs it.
+	*	\return the id to use in ScriptJob::scriptId */
+	int AddScript( const char* source );
+
+	void Submit( ScriptJob job );
+
+	/*! \brief Blocks until every submitted job has run */
+	void WaitIdle();
+
+	int NumThreads() const { return (int)m_workers.size(); }
+	uint64_t NumJobsRun() const { return m_numJobsRun; }
+	uint64_t NumJobsStolen() const { return m_numJobsStolen; }
+
+private:
+	struct Worker
+	{
+		std::thread m_thread;
+		std::mutex m_queueMutex;
+		std::deque<ScriptJob> m_queue;
+		std::vector<char> m_memory;
+		std::unique_ptr<ArenaAllocator> m_allocator;
+		std::unordered_map<int, lua_State*> m_states;	//scriptId -> this worker's state for it
+	};
+
+	void WorkerLoop( int workerIdx );
+	bool PopJob( Worker& worker, ScriptJob& job );
+	bool StealJob( int thiefIdx, ScriptJob& job );
+	void RunJob( Worker& worker, ScriptJob& job );
+	lua_State* GetState( Worker& worker, int scriptId );
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+
+	std::mutex m_scriptsMutex;
+	std::vector<std::string> m_scripts;
+
+	std::atomic<bool> m_stop;
+	std::atomic<int> m_numQueued;		//jobs sitting in a queue
+	std::atomic<int> m_numPending;		//jobs submitted but not finished
+	std::atomic<uint64_t> m_numJobsRun;
+	std::atomic<uint64_t> m_numJobsStolen;
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_workAvailable;
+	std::condition_variable m_idle;
+};
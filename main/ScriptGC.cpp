@@ -0,0 +1,118 @@
+#include "ScriptGC.h"
+#include "ArenaAllocator.h"
+#include "ScriptTrace.h"
+#include <chrono>
+#include <cstdio>
+
+using GCClock = std::chrono::steady_clock;
+
+static uint64_t ToNs( GCClock::duration d )
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( d ).count();
+}
+
+ScriptGC::ScriptGC( lua_State* L, ArenaAllocator* allocator ) :
+	m_stepKB( 0 ),
+	m_pressureThreshold( 0.75 ),
+	m_L( L ),
+	m_allocator( allocator ),
+	m_cycleNs( 0 ),
+	m_numCyclesFinished( 0 ),
+	m_numFallbacksTraced( allocator ? allocator->m_numFallbackAllocations : 0 )
+{
+}
+
+void ScriptGC::SetIncrementalParams( int pause, int stepMul )
+{
+	lua_gc( m_L, LUA_GCSETPAUSE, pause );
+	lua_gc( m_L, LUA_GCSETSTEPMUL, stepMul );
+}
+
+void ScriptGC::SetAutomatic( bool automatic )
+{
+	lua_gc( m_L, automatic ? LUA_GCRESTART : LUA_GCSTOP, 0 );
+}
+
+bool ScriptGC::Step( double budgetMicroseconds )
+{
+	const GCClock::time_point deadline = GCClock::now() +
+		std::chrono::duration_cast<GCClock::duration>( std::chrono::duration<double, std::micro>( budgetMicroseconds ) );
+
+	//the allocator has no trace code of its own, allocations that fell back since the last step are traced here
+	if ( m_allocator && m_allocator->m_numFallbackAllocations != m_numFallbacksTraced )
+	{
+		m_numFallbacksTraced = m_allocator->m_numFallbackAllocations;
+		RecordTraceInstant( "allocator fallback", "alloc" );
+	}
+
+	int stepKB = m_stepKB;
+	if ( MemoryPressure() > m_pressureThreshold )
+	{
+		stepKB = m_stepKB > 0 ? m_stepKB * 4 : 4;
+	}
+
+	//stop when the next step, guessed to take as long as the last one, would overrun the budget
+	GCClock::duration lastStep( 0 );
+	for ( ;; )
+	{
+		GCClock::time_point stepStart = GCClock::now();
+		if ( stepStart + lastStep > deadline )
+		{
+			return false;
+		}
+
+		int finishedCycle = 0;
+		{
+			ScopedTraceSpan span( "gc step", "gc" );
+			finishedCycle = lua_gc( m_L, LUA_GCSTEP, stepKB );
+		}
+		lastStep = GCClock::now() - stepStart;
+		uint64_t stepNs = ToNs( lastStep );
+		m_stepTimes.Record( stepNs );
+		m_cycleNs += stepNs;
+
+		if ( finishedCycle )
+		{
+			m_cycleTimes.Record( m_cycleNs );
+			m_cycleNs = 0;
+			m_numCyclesFinished++;
+			return true;
+		}
+	}
+}
+
+void ScriptGC::FullCollect()
+{
+	ScopedTraceSpan span( "gc full collect", "gc" );
+	GCClock::time_point start = GCClock::now();
+	lua_gc( m_L, LUA_GCCOLLECT, 0 );
+	m_cycleTimes.Record( ToNs( GCClock::now() - start ) );
+	m_cycleNs = 0;
+	m_numCyclesFinished++;
+}
+
+double ScriptGC::MemoryPressure() const
+{
+	if ( m_allocator == nullptr || m_allocator->Capacity() == 0 )
+	{
+		return 0.0;
+	}
+	return (double)m_allocator->m_numBytesInUse / m_allocator->Capacity();
+}
+
+static void PrintHistogram( const char* name, const LatencyHistogram& histogram )
+{
+	printf( "  %s: %llu, mean %.1fus, p50 <%.1fus, p99 <%.1fus, max %.1fus\n", name,
+		(unsigned long long)histogram.Count(),
+		histogram.MeanNs() / 1000.0,
+		histogram.PercentileNs( 50 ) / 1000.0,
+		histogram.PercentileNs( 99 ) / 1000.0,
+		histogram.MaxNs() / 1000.0 );
+}
+
+void ScriptGC::PrintStats( const char* name ) const
+{
+	printf( "%s gc: %dKB in use, pressure %.2f\n", name, lua_gc( m_L, LUA_GCCOUNT, 0 ), MemoryPressure() );
+	PrintHistogram( "steps", m_stepTimes );
+	PrintHistogram( "cycles", m_cycleTimes );
+}
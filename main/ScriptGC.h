@@ -0,0 +1,52 @@
+#pragma once
+#include "lua.hpp"
+#include "LatencyHistogram.h"
+
+struct ArenaAllocator;
+
+/*! \brief Controls when a state's garbage collector runs.
+*	Turn off the automatic collector with SetAutomatic(false) and call Step() in idle time,
+*	so GC work doesn't land in the middle of latency critical calls.
+*	Every step & full cycle is timed into a histogram.
+*	NOTE: call from the thread that owns the state. */
+class ScriptGC
+{
+public:
+	/*! \param allocator the ArenaAllocator #L was made with, used to measure memory pressure. Can be nullptr. */
+	ScriptGC( lua_State* L, ArenaAllocator* allocator = nullptr );
+
+	/*! \brief lua_gc LUA_GCSETPAUSE & LUA_GCSETSTEPMUL, see the Lua manual 2.5.1 */
+	void SetIncrementalParams( int pause, int stepMul );
+
+	/*! \brief Start (LUA_GCRESTART) or stop (LUA_GCSTOP) the automatic collector */
+	void SetAutomatic( bool automatic );
+
+	/*! \brief Does incremental steps for up to #budgetMicroseconds.
+	*	Under memory pressure bigger steps are taken so collection keeps up with allocation.
+	*	\return true if a collection cycle finished */
+	bool Step( double budgetMicroseconds );
+
+	/*! \brief A full, blocking collection, timed into CycleTimes() */
+	void FullCollect();
+
+	/*! \return bytes in use / the allocator's arena size, above 1 once it has overflowed into the fallback allocator */
+	double MemoryPressure() const;
+
+	const LatencyHistogram& StepTimes() const { return m_stepTimes; }
+	const LatencyHistogram& CycleTimes() const { return m_cycleTimes; }		//time spent in each finished cycle, summed over its steps
+	int NumCyclesFinished() const { return m_numCyclesFinished; }
+
+	void PrintStats( const char* name ) const;
+
+	int m_stepKB;					//amount of work per lua_gc(LUA_GCSTEP) call, 0 = one basic step
+	double m_pressureThreshold;		//above this MemoryPressure() steps are 4x bigger
+
+private:
+	lua_State* m_L;
+	ArenaAllocator* m_allocator;
+	LatencyHistogram m_stepTimes;
+	LatencyHistogram m_cycleTimes;
+	uint64_t m_cycleNs;			//step time so far in the current cycle
+	int m_numCyclesFinished;
+	size_t m_numFallbacksTraced;	//m_allocator's m_numFallbackAllocations when it was last traced
+};
@@ -0,0 +1,185 @@
+#include "ScriptProfiler.h"
+#include "AutomatedBinding.h"
+#include <assert.h>
+#include <chrono>
+#include <cstdio>
+
+static char PROFILER_KEY;		//registry[&PROFILER_KEY] = the running ScriptProfiler
+static constexpr int TIMER_HOOK_INSTRUCTIONS = 1000;
+
+static ScriptProfiler* GetProfiler( lua_State* L )
+{
+	lua_rawgetp( L, LUA_REGISTRYINDEX, &PROFILER_KEY );
+	ScriptProfiler* profiler = (ScriptProfiler*)lua_touserdata( L, -1 );
+	lua_pop( L, 1 );
+	return profiler;
+}
+
+void ScriptProfilerHook( lua_State* L, lua_Debug* /*ar*/ )
+{
+	ScriptProfiler* profiler = GetProfiler( L );
+	if ( profiler && profiler->TakeSample() )
+	{
+		profiler->Sample( L );
+	}
+}
+
+void SampleNativeCall( lua_State* L )
+{
+	ScriptProfiler* profiler = GetProfiler( L );
+	if ( profiler && profiler->SamplesNativeCalls() && profiler->TakeSample() )
+	{
+		profiler->Sample( L );		//the bound function is the innermost frame
+	}
+}
+
+static std::string NativeFrameName( const rttr::method& m )
+{
+	std::string name;
+	rttr::type declaringType = m.get_declaring_type();
+	if ( declaringType.is_valid() )
+	{
+		name = declaringType.get_name().to_string();
+		name += '.';
+	}
+	name += m.get_name().to_string();
+	name += " [native]";
+	return name;
+}
+
+ScriptProfiler::ScriptProfiler( lua_State* L, ProfilerClock clock, int interval ) :
+	m_L( L ),
+	m_clock( clock ),
+	m_interval( interval > 0 ? interval : 1000 ),
+	m_isRunning( false ),
+	m_timerRunning( false ),
+	m_sampleDue( false ),
+	m_numSamples( 0 )
+{
+}
+
+ScriptProfiler::~ScriptProfiler()
+{
+	Stop();
+}
+
+void ScriptProfiler::Start()
+{
+	if ( m_isRunning )
+	{
+		return;
+	}
+	assert( GetProfiler( m_L ) == nullptr );		//one profiler per state
+	m_isRunning = true;
+	lua_pushlightuserdata( m_L, this );
+	lua_rawsetp( m_L, LUA_REGISTRYINDEX, &PROFILER_KEY );
+
+	if ( m_clock == ProfilerClock::Timer )
+	{
+		m_sampleDue = false;
+		m_timerRunning = true;
+		m_timer = std::thread( [this]()
+		{
+			while ( m_timerRunning.load( std::memory_order_relaxed ) )
+			{
+				std::this_thread::sleep_for( std::chrono::microseconds( m_interval ) );
+				m_sampleDue.store( true, std::memory_order_relaxed );
+			}
+		} );
+		lua_sethook( m_L, ScriptProfilerHook, LUA_MASKCOUNT, TIMER_HOOK_INSTRUCTIONS );
+	}
+	else
+	{
+		lua_sethook( m_L, ScriptProfilerHook, LUA_MASKCOUNT, m_interval );
+	}
+}
+
+void ScriptProfiler::Stop()
+{
+	if ( m_isRunning == false )
+	{
+		return;
+	}
+	m_isRunning = false;
+	lua_sethook( m_L, nullptr, 0, 0 );
+	lua_pushnil( m_L );
+	lua_rawsetp( m_L, LUA_REGISTRYINDEX, &PROFILER_KEY );
+
+	if ( m_timerRunning.exchange( false ) )
+	{
+		m_timer.join();
+	}
+}
+
+void ScriptProfiler::Clear()
+{
+	m_stacks.clear();
+	m_numSamples = 0;
+}
+
+bool ScriptProfiler::TakeSample()
+{
+	if ( m_clock == ProfilerClock::Instructions )
+	{
+		return true;
+	}
+	//only pay for the exchange when the timer has fired
+	return m_sampleDue.load( std::memory_order_relaxed ) && m_sampleDue.exchange( false, std::memory_order_relaxed );
+}
+
+void ScriptProfiler::Sample( lua_State* L )
+{
+	//walk from the innermost frame out
+	m_frames.clear();
+	lua_Debug ar;
+	for ( int level = 0; lua_getstack( L, level, &ar ); level++ )
+	{
+		lua_getinfo( L, "Snf", &ar );
+		const rttr::method* bound = GetBoundMethod( L, -1 );
+		lua_pop( L, 1 );	//the function
+
+		if ( bound )
+		{
+			m_frames.push_back( NativeFrameName( *bound ) );
+		}
+		else if ( ar.what[0] == 'm' )	//"main"
+		{
+			m_frames.push_back( std::string( "main " ) + ar.short_src );
+		}
+		else
+		{
+			char frame[256];
+			snprintf( frame, sizeof( frame ), "%s %s:%d", ar.name ? ar.name : "?",
+				ar.what[0] == 'C' ? "[C]" : ar.short_src, ar.linedefined );
+			m_frames.push_back( frame );
+		}
+	}
+
+	m_stack.clear();
+	for ( auto it = m_frames.rbegin(); it != m_frames.rend(); ++it )
+	{
+		if ( m_stack.empty() == false )
+		{
+			m_stack += ';';
+		}
+		m_stack += *it;
+	}
+	m_stacks[m_stack]++;
+	m_numSamples++;
+}
+
+bool ScriptProfiler::WriteFoldedStacks( const char* fileName ) const
+{
+	FILE* f = fopen( fileName, "w" );
+	if ( f == nullptr )
+	{
+		printf( "unable to open '%s' for writing\n", fileName );
+		return false;
+	}
+	for ( auto& stack : m_stacks )
+	{
+		fprintf( f, "%s %d\n", stack.first.c_str(), stack.second );
+	}
+	fclose( f );
+	return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "lua.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*! \brief What decides when ScriptProfiler takes a sample */
+enum class ProfilerClock
+{
+	Instructions,	//every N VM instructions, only sees time spent running Lua
+	Timer,			//every N microseconds, also sees time spent in bound native functions
+};
+
+/*! \brief Sampling profiler for one lua_State, writes folded stacks ("main;Update;Sprite.Move [native] 12")
+*	for flamegraph.pl, speedscope & friends.
+*	Samples are taken from a count hook, in timer mode a background thread just raises a flag that the hook
+*	checks every 1000 instructions, so the cost while running is a hook call per 1000 instructions.
+*	NOTE: Lua has one hook per thread, so ExecuteScriptBudgeted/ResumeScriptBudgeted replace it while they run.
+*	Coroutines inherit the hook when they are created, threads created before Start() aren't sampled. */
+class ScriptProfiler
+{
+public:
+	/*! \param interval instructions or microseconds between samples, depending on #clock */
+	ScriptProfiler( lua_State* L, ProfilerClock clock = ProfilerClock::Timer, int interval = 1000 );
+	~ScriptProfiler();
+
+	ScriptProfiler( const ScriptProfiler& ) = delete;
+	ScriptProfiler& operator=( const ScriptProfiler& ) = delete;
+
+	void Start();
+	void Stop();
+	bool IsRunning() const { return m_isRunning; }
+
+	void Clear();
+	int NumSamples() const { return m_numSamples; }
+
+	/*! \return false if the file couldn't be written */
+	bool WriteFoldedStacks( const char* fileName ) const;
+
+	// used by the hook & the binding layer
+	bool TakeSample();
+	void Sample( lua_State* L );
+	bool SamplesNativeCalls() const { return m_clock == ProfilerClock::Timer; }
+
+private:
+	lua_State* m_L;
+	ProfilerClock m_clock;
+	int m_interval;
+	bool m_isRunning;
+
+	std::atomic<bool> m_timerRunning;
+	std::atomic<bool> m_sampleDue;
+	std::thread m_timer;
+
+	std::unordered_map<std::string, int> m_stacks;		//folded stack -> number of samples
+	int m_numSamples;
+	std::vector<std::string> m_frames;					//reused by Sample
+	std::string m_stack;
+};
+
+/*! \brief The hook a running ScriptProfiler installs */
+void ScriptProfilerHook( lua_State* L, lua_Debug* ar );
+
+void SampleNativeCall( lua_State* L );
+
+/*! \brief Called by InvokeMethod after a native function returns, so time spent in native code is
+*	attributed to it & not to the next Lua instruction. One compare when the profiler isn't running. */
+inline void ProfileNativeCall( lua_State* L )
+{
+	if ( lua_gethook( L ) == ScriptProfilerHook )
+	{
+		SampleNativeCall( L );
+	}
+}
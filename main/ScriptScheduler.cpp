@@ -0,0 +1,250 @@
+#include "ScriptScheduler.h"
+#include "AutomatedBinding.h"
+#include <cstdio>
+#include <assert.h>
+
+//address used as the registry key of the state's ScriptScheduler
+static const char SCHEDULER_KEY = 0;
+
+static ScriptScheduler* FindScheduler( lua_State* L )
+{
+	lua_rawgetp( L, LUA_REGISTRYINDEX, &SCHEDULER_KEY );
+	ScriptScheduler* scheduler = (ScriptScheduler*)lua_touserdata( L, -1 );
+	lua_pop( L, 1 );
+	return scheduler;
+}
+
+PendingResult::PendingResult() :
+	m_operation( std::make_shared<AsyncOperation>() )
+{
+}
+
+void PendingResult::Complete( rttr::variant result ) const
+{
+	{
+		std::lock_guard<std::mutex> lock( m_operation->m_mutex );
+		assert( m_operation->m_isComplete == false );		//can only complete once
+		m_operation->m_result = std::move( result );
+		m_operation->m_isComplete = true;
+		//still holding the lock ~ScriptScheduler takes to clear m_scheduler, so it can't be destroyed under us
+		if ( m_operation->m_scheduler )
+		{
+			m_operation->m_scheduler->OnComplete( m_operation->m_waiting );
+		}
+	}
+	m_operation->m_completed.notify_all();
+}
+
+ScriptScheduler::ScriptScheduler( lua_State* L ) :
+	m_L( L ),
+	m_running( nullptr ),
+	m_numThreadsCreated( 0 )
+{
+	assert( FindScheduler( L ) == nullptr );	//only one scheduler per state
+	lua_pushlightuserdata( L, this );
+	lua_rawsetp( L, LUA_REGISTRYINDEX, &SCHEDULER_KEY );
+}
+
+ScriptScheduler::~ScriptScheduler()
+{
+	//anything still waiting is abandoned, stop its operation telling us when it completes
+	for ( auto& waiting : m_waiting )
+	{
+		if ( waiting.second.second )
+		{
+			std::lock_guard<std::mutex> lock( waiting.second.second->m_mutex );
+			waiting.second.second->m_scheduler = nullptr;
+		}
+		luaL_unref( m_L, LUA_REGISTRYINDEX, waiting.second.first.m_ref );
+	}
+	for ( auto& thread : m_freeThreads )
+	{
+		luaL_unref( m_L, LUA_REGISTRYINDEX, thread.m_ref );
+	}
+
+	lua_pushnil( m_L );
+	lua_rawsetp( m_L, LUA_REGISTRYINDEX, &SCHEDULER_KEY );
+}
+
+/*! \brief Pushes each rttr::variant in the std::vector passed as lightuserdata */
+static int PushArgs( lua_State* L )
+{
+	std::vector<rttr::variant>* args = (std::vector<rttr::variant>*)lua_touserdata( L, 1 );
+	lua_settop( L, 0 );
+	int numArgs = 0;
+	for ( auto& arg : *args )
+	{
+		numArgs += ToLua( L, arg );
+	}
+	return numArgs;
+}
+
+void ScriptScheduler::Spawn( const char* funcName, std::vector<rttr::variant> args )
+{
+	Thread thread;
+	if ( m_freeThreads.empty() )
+	{
+		thread.m_co = lua_newthread( m_L );
+		thread.m_ref = luaL_ref( m_L, LUA_REGISTRYINDEX );
+		m_numThreadsCreated++;
+	}
+	else
+	{
+		thread = m_freeThreads.back();
+		m_freeThreads.pop_back();
+	}
+
+	if ( lua_getglobal( thread.m_co, funcName ) != LUA_TFUNCTION )
+	{
+		printf( "unknown script function '%s'\n", funcName );
+		lua_settop( thread.m_co, 0 );
+		m_freeThreads.push_back( thread );
+		return;
+	}
+
+	//marshalled on the main state under lua_pcall, as ToLua raises a Lua error for an arg it can't marshal
+	int top = lua_gettop( m_L );
+	lua_pushcfunction( m_L, PushArgs );
+	lua_pushlightuserdata( m_L, &args );
+	if ( lua_pcall( m_L, 1, LUA_MULTRET, 0 ) != LUA_OK )
+	{
+		printf( "unable to spawn script function '%s', '%s'\n", funcName, lua_tostring( m_L, -1 ) );
+		lua_settop( m_L, top );
+		lua_settop( thread.m_co, 0 );
+		m_freeThreads.push_back( thread );
+		return;
+	}
+	int numArgs = lua_gettop( m_L ) - top;
+	lua_xmove( m_L, thread.m_co, numArgs );
+	Run( thread, numArgs );
+}
+
+void ScriptScheduler::Run( Thread thread, int numArgs )
+{
+	lua_State* wasRunning = m_running;
+	m_running = thread.m_co;
+	int status = lua_resume( thread.m_co, m_L, numArgs );
+	m_running = wasRunning;
+
+	if ( status == LUA_YIELD )
+	{
+		auto it = m_waiting.find( thread.m_co );
+		if ( it == m_waiting.end() )
+		{
+			//yielded without waiting on a PendingResult, carry on next tick
+			m_waiting[thread.m_co] = { thread, nullptr };
+			OnComplete( thread.m_co );
+		}
+		else
+		{
+			it->second.first = thread;
+		}
+	}
+	else if ( status == LUA_OK )
+	{
+		//finished, the thread can be reused for another task
+		lua_settop( thread.m_co, 0 );
+		m_freeThreads.push_back( thread );
+	}
+	else
+	{
+		//a thread that raised an error can't be resumed again
+		printf( "Error: %s\n", lua_tostring( thread.m_co, -1 ) );
+		luaL_unref( m_L, LUA_REGISTRYINDEX, thread.m_ref );
+	}
+}
+
+int ScriptScheduler::Tick()
+{
+	std::vector<lua_State*> completed;
+	{
+		std::lock_guard<std::mutex> lock( m_completedMutex );
+		completed.swap( m_completed );
+	}
+
+	int numResumed = 0;
+	for ( lua_State* co : completed )
+	{
+		auto it = m_waiting.find( co );
+		if ( it == m_waiting.end() )
+		{
+			continue;
+		}
+		Thread thread = it->second.first;
+		m_resuming = std::move( it->second.second );
+		m_waiting.erase( it );
+
+		Run( thread, 0 );		//ContinueAfterPendingResult pushes m_resuming's result
+		m_resuming.reset();
+		numResumed++;
+	}
+	return numResumed;
+}
+
+void ScriptScheduler::Wait( lua_State* co, const std::shared_ptr<AsyncOperation>& operation )
+{
+	m_waiting[co].second = operation;
+	std::lock_guard<std::mutex> lock( operation->m_mutex );
+	if ( operation->m_isComplete )
+	{
+		OnComplete( co );
+	}
+	else
+	{
+		operation->m_scheduler = this;
+		operation->m_waiting = co;
+	}
+}
+
+void ScriptScheduler::OnComplete( lua_State* co )
+{
+	std::lock_guard<std::mutex> lock( m_completedMutex );
+	m_completed.push_back( co );
+}
+
+int ScriptScheduler::PushResumedResult( lua_State* co )
+{
+	int numResults = 0;
+	if ( m_resuming && m_resuming->m_result.is_valid() )
+	{
+		numResults = ToLua( co, m_resuming->m_result );
+	}
+	if ( numResults == 0 )
+	{
+		lua_pushnil( co );
+		numResults = 1;
+	}
+	return numResults;
+}
+
+int WaitOnPendingResult( lua_State* L, const PendingResult& pending )
+{
+	ScriptScheduler* scheduler = FindScheduler( L );
+	if ( scheduler && scheduler->IsRunning( L ) && lua_isyieldable( L ) )
+	{
+		scheduler->Wait( L, pending.m_operation );
+		return PENDING_RESULT;
+	}
+
+	//not a coroutine we can resume later, all we can do is block
+	AsyncOperation& operation = *pending.m_operation;
+	rttr::variant result;
+	{
+		std::unique_lock<std::mutex> lock( operation.m_mutex );
+		operation.m_completed.wait( lock, [&operation]() { return operation.m_isComplete; } );
+		result = operation.m_result;
+	}
+	return result.is_valid() ? ToLua( L, result ) : 0;
+}
+
+static int ContinueAfterPendingResult( lua_State* L, int /*status*/, lua_KContext /*ctx*/ )
+{
+	ScriptScheduler* scheduler = FindScheduler( L );
+	assert( scheduler );
+	return scheduler->PushResumedResult( L );
+}
+
+int YieldForPendingResult( lua_State* L )
+{
+	return lua_yieldk( L, 0, 0, ContinueAfterPendingResult );
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "lua.hpp"
+#include <rttr/type>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class ScriptScheduler;
+
+/*! \brief Shared between a slow native operation and the script waiting on its result */
+struct AsyncOperation
+{
+	std::mutex m_mutex;
+	std::condition_variable m_completed;
+	bool m_isComplete = false;
+	rttr::variant m_result;
+	ScriptScheduler* m_scheduler = nullptr;		//set when a scheduled coroutine is waiting on it
+	lua_State* m_waiting = nullptr;
+};
+
+/*! \brief Return this from a bound native function that can't give its result straight away.
+*	- Called from a coroutine run by a ScriptScheduler, the coroutine yields and is resumed with the result
+*	  on the first ScriptScheduler::Tick() after Complete() is called.
+*	- Called from anywhere else, the call blocks until Complete() is called. */
+class PendingResult
+{
+public:
+	PendingResult();
+
+	/*! \brief Gives the result to the waiting script, can be called from any thread */
+	void Complete( rttr::variant result ) const;
+
+	std::shared_ptr<AsyncOperation> m_operation;
+};
+
+/*! \brief Runs script functions as coroutines that can wait on PendingResults.
+*	Coroutine threads are pooled & reused once a task finishes, so thousands of tasks can share one lua_State.
+*	NOTE: everything but PendingResult::Complete must be called from the thread that owns the lua_State. */
+class ScriptScheduler
+{
+public:
+	/*! \param L a state made with CreateScript, only one scheduler per state */
+	explicit ScriptScheduler( lua_State* L );
+	~ScriptScheduler();
+
+	ScriptScheduler( const ScriptScheduler& ) = delete;
+	ScriptScheduler& operator=( const ScriptScheduler& ) = delete;
+
+	/*! \brief Runs global function #funcName as a new task, until it finishes or waits on a PendingResult */
+	void Spawn( const char* funcName, std::vector<rttr::variant> args = {} );
+
+	/*! \brief Resumes every task whose PendingResult has completed since the last tick
+	*	\return the number of tasks resumed */
+	int Tick();
+
+	int NumWaiting() const { return (int)m_waiting.size(); }
+	int NumPooledThreads() const { return (int)m_freeThreads.size(); }
+	int NumThreadsCreated() const { return m_numThreadsCreated; }
+
+	/*! \return true if #co is the coroutine this scheduler is currently running */
+	bool IsRunning( lua_State* co ) const { return co == m_running; }
+
+	// used by the binding layer
+	void Wait( lua_State* co, const std::shared_ptr<AsyncOperation>& operation );
+	void OnComplete( lua_State* co );
+	int PushResumedResult( lua_State* co );
+
+private:
+	struct Thread
+	{
+		lua_State* m_co = nullptr;
+		int m_ref = LUA_NOREF;		//keeps the thread alive in the registry
+	};
+
+	void Run( Thread thread, int numArgs );
+
+	lua_State* m_L;
+	std::vector<Thread> m_freeThreads;
+	std::unordered_map<lua_State*, std::pair<Thread, std::shared_ptr<AsyncOperation>>> m_waiting;
+	std::shared_ptr<AsyncOperation> m_resuming;		//the operation whose result is being handed back to a coroutine
+	lua_State* m_running;
+	int m_numThreadsCreated;
+
+	std::mutex m_completedMutex;
+	std::vector<lua_State*> m_completed;
+};
+
+/*! \brief Returned by InvokeMethod when the calling coroutine has to yield */
+constexpr int PENDING_RESULT = -1;
+
+/*! \brief Called by InvokeMethod when a native function returns a PendingResult.
+*	\return PENDING_RESULT if L is a scheduled coroutine that must now yield,
+*	otherwise it has blocked for the result & returns the number of values pushed. */
+int WaitOnPendingResult( lua_State* L, const PendingResult& pending );
+
+/*! \brief Yields until the PendingResult completes, must be returned from the lua_CFunction Lua called.
+*	lua_yieldk longjmps, so there mustn't be any C++ objects with destructors left on the native stack. */
+int YieldForPendingResult( lua_State* L );
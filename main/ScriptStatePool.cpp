@@ -0,0 +1,240 @@
+#include "ScriptStatePool.h"
+#include "ArenaAllocator.h"
+#include "AutomatedBinding.h"
+#include <cstdio>
+#include <string.h>
+#include <assert.h>
+
+//address used as the registry key of the baseline snapshot
+static const char BASELINE_KEY = 0;
+
+enum BaselineSlots
+{
+	BASELINE_GLOBALS = 1,	//copy of _G
+	BASELINE_TABLES = 2,	//table referenced from _G -> copy of that table
+	BASELINE_METATABLES = 3,	//name of a metatable in the registry -> copy of it
+};
+
+/*! \return true if the registry key at #keyIdx names a metatable, they all end in "_MT_" (see MetaTableName) */
+static bool IsMetaTableName( lua_State* L, int keyIdx )
+{
+	if ( lua_type( L, keyIdx ) != LUA_TSTRING )
+	{
+		return false;
+	}
+	size_t length = 0;
+	const char* name = lua_tolstring( L, keyIdx, &length );
+	return length >= 4 && memcmp( name + length - 4, "_MT_", 4 ) == 0;
+}
+
+/*! \brief Pushes a shallow copy of the table at #tableIdx */
+static void CopyTable( lua_State* L, int tableIdx )
+{
+	lua_newtable( L );
+	int copyIdx = lua_gettop( L );
+	lua_pushnil( L );
+	while ( lua_next( L, tableIdx ) != 0 )
+	{
+		lua_pushvalue( L, -2 );		//key value key
+		lua_insert( L, -2 );		//key key value
+		lua_rawset( L, copyIdx );	//copy[key] = value
+	}
+}
+
+/*! \brief Make the table at #tableIdx match the copy at #snapshotIdx again */
+static void RestoreTable( lua_State* L, int tableIdx, int snapshotIdx )
+{
+	//remove anything that has been added
+	lua_pushnil( L );
+	while ( lua_next( L, tableIdx ) != 0 )
+	{
+		lua_pop( L, 1 );
+		lua_pushvalue( L, -1 );
+		bool inBaseline = lua_rawget( L, snapshotIdx ) != LUA_TNIL;
+		lua_pop( L, 1 );
+		if ( inBaseline == false )
+		{
+			//clearing an existing field while traversing is allowed by lua_next
+			lua_pushvalue( L, -1 );
+			lua_pushnil( L );
+			lua_rawset( L, tableIdx );
+		}
+	}
+
+	//put back anything that has been changed or removed
+	lua_pushnil( L );
+	while ( lua_next( L, snapshotIdx ) != 0 )
+	{
+		lua_pushvalue( L, -2 );
+		lua_insert( L, -2 );
+		lua_rawset( L, tableIdx );
+	}
+}
+
+void SnapshotScriptGlobals( lua_State* L )
+{
+	int top = lua_gettop( L );
+	lua_createtable( L, 2, 0 );
+	int baselineIdx = lua_gettop( L );
+
+	lua_pushglobaltable( L );
+	int globalsIdx = lua_gettop( L );
+	CopyTable( L, globalsIdx );
+	lua_rawseti( L, baselineIdx, BASELINE_GLOBALS );
+
+	//the bound tables, Global & a table per class
+	lua_newtable( L );
+	int tablesIdx = lua_gettop( L );
+	lua_pushnil( L );
+	while ( lua_next( L, globalsIdx ) != 0 )
+	{
+		if ( lua_istable( L, -1 ) && lua_rawequal( L, -1, globalsIdx ) == false )
+		{
+			int valueIdx = lua_gettop( L );
+			lua_pushvalue( L, valueIdx );
+			CopyTable( L, valueIdx );
+			lua_rawset( L, tablesIdx );
+		}
+		lua_pop( L, 1 );
+	}
+	lua_rawseti( L, baselineIdx, BASELINE_TABLES );
+
+	//the class metatables, a script can change them through getmetatable( ud )
+	lua_newtable( L );
+	int metaTablesIdx = lua_gettop( L );
+	lua_pushnil( L );
+	while ( lua_next( L, LUA_REGISTRYINDEX ) != 0 )
+	{
+		if ( lua_istable( L, -1 ) && IsMetaTableName( L, -2 ) )
+		{
+			int valueIdx = lua_gettop( L );
+			lua_pushvalue( L, valueIdx - 1 );
+			CopyTable( L, valueIdx );
+			lua_rawset( L, metaTablesIdx );
+		}
+		lua_pop( L, 1 );
+	}
+	lua_rawseti( L, baselineIdx, BASELINE_METATABLES );
+
+	lua_pushvalue( L, baselineIdx );
+	lua_rawsetp( L, LUA_REGISTRYINDEX, &BASELINE_KEY );
+	lua_settop( L, top );
+}
+
+void ResetScriptGlobals( lua_State* L )
+{
+	lua_settop( L, 0 );
+	if ( lua_rawgetp( L, LUA_REGISTRYINDEX, &BASELINE_KEY ) != LUA_TTABLE )
+	{
+		assert( false );	//SnapshotScriptGlobals wasn't called on this state
+		lua_settop( L, 0 );
+		return;
+	}
+	int baselineIdx = lua_gettop( L );
+
+	lua_pushglobaltable( L );
+	int globalsIdx = lua_gettop( L );
+	lua_rawgeti( L, baselineIdx, BASELINE_GLOBALS );
+	RestoreTable( L, globalsIdx, globalsIdx + 1 );
+	lua_pop( L, 1 );
+
+	lua_rawgeti( L, baselineIdx, BASELINE_TABLES );
+	int tablesIdx = lua_gettop( L );
+	lua_pushnil( L );
+	while ( lua_next( L, tablesIdx ) != 0 )
+	{
+		RestoreTable( L, lua_gettop( L ) - 1, lua_gettop( L ) );
+		lua_pop( L, 1 );
+	}
+	lua_pop( L, 1 );
+
+	//metatables from the snapshot are put back, ones made since are dropped so they're made afresh when next needed
+	lua_rawgeti( L, baselineIdx, BASELINE_METATABLES );
+	int metaTablesIdx = lua_gettop( L );
+	lua_pushnil( L );
+	while ( lua_next( L, LUA_REGISTRYINDEX ) != 0 )
+	{
+		if ( lua_istable( L, -1 ) && IsMetaTableName( L, -2 ) )
+		{
+			int valueIdx = lua_gettop( L );
+			lua_pushvalue( L, valueIdx - 1 );
+			if ( lua_rawget( L, metaTablesIdx ) == LUA_TTABLE )
+			{
+				RestoreTable( L, valueIdx, valueIdx + 1 );
+			}
+			else
+			{
+				lua_pushvalue( L, valueIdx - 1 );
+				lua_pushnil( L );
+				lua_rawset( L, LUA_REGISTRYINDEX );		//clearing an existing field while traversing is allowed
+			}
+		}
+		lua_settop( L, metaTablesIdx + 1 );		//leave the key for lua_next
+	}
+
+	lua_settop( L, 0 );
+	lua_gc( L, LUA_GCCOLLECT, 0 );
+}
+
+ScriptStatePool::ScriptStatePool( int numStates, size_t poolSizeBytes ) :
+	m_poolSizeBytes( poolSizeBytes )
+{
+	for ( int i = 0; i < numStates; i++ )
+	{
+		PooledState* state = CreateState();
+		state->m_isFree = true;
+		m_free.push_back( state );
+	}
+}
+
+ScriptStatePool::~ScriptStatePool()
+{
+	assert( m_free.size() == m_states.size() );		//a state wasn't released
+	for ( auto& state : m_states )
+	{
+		CloseScript( state->m_L );
+	}
+}
+
+ScriptStatePool::PooledState* ScriptStatePool::CreateState()
+{
+	std::unique_ptr<PooledState> state( new PooledState() );
+	state->m_memory.resize( m_poolSizeBytes );
+	state->m_allocator.reset( new ArenaAllocator( state->m_memory.data(), &state->m_memory[m_poolSizeBytes - 1] ) );
+	state->m_L = CreateScript( *state->m_allocator );
+	state->m_isFree = false;		//handed out, unless the constructor puts it in m_free
+	SnapshotScriptGlobals( state->m_L );
+
+	PooledState* pooledState = state.get();
+	m_byLuaState[pooledState->m_L] = pooledState;
+	m_states.push_back( std::move( state ) );
+	return pooledState;
+}
+
+lua_State* ScriptStatePool::Acquire()
+{
+	if ( m_free.empty() )
+	{
+		return CreateState()->m_L;
+	}
+	PooledState* state = m_free.back();
+	m_free.pop_back();
+	state->m_isFree = false;
+	return state->m_L;
+}
+
+void ScriptStatePool::Release( lua_State* L )
+{
+	auto it = m_byLuaState.find( L );
+	assert( it != m_byLuaState.end() );		//not one of ours!
+	if ( it->second->m_isFree )
+	{
+		//putting it in m_free twice would hand the same state to two tenants
+		printf( "ScriptStatePool::Release - state %p was already released\n", (void*)L );
+		assert( false );
+		return;
+	}
+	ResetScriptGlobals( L );
+	it->second->m_isFree = true;
+	m_free.push_back( it->second );
+}
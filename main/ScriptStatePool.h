@@ -0,0 +1,56 @@
+#pragma once
+#include "lua.hpp"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct ArenaAllocator;
+
+/*! \brief Keeps a set of bound lua_States ready to be handed out.
+*	Each state is made once with CreateScript and owns its own ArenaAllocator.
+*	Release() resets the globals, every bound table & the bound metatables back to a snapshot taken straight
+*	after binding and runs a full GC, so the next Acquire() doesn't have to redo the binding.
+*	Anything else a tenant puts in the registry (e.g. with the debug library) isn't reset.
+*	NOTE: not thread safe, use one pool per thread. */
+class ScriptStatePool
+{
+public:
+	/*! \param numStates number of states to create up front
+	*	\param poolSizeBytes size of the memory pool given to each state's ArenaAllocator */
+	ScriptStatePool( int numStates, size_t poolSizeBytes = 1024 * 64 );
+	~ScriptStatePool();
+
+	ScriptStatePool( const ScriptStatePool& ) = delete;
+	ScriptStatePool& operator=( const ScriptStatePool& ) = delete;
+
+	/*! \brief Takes a bound state from the pool, a new one is created if the pool is empty */
+	lua_State* Acquire();
+
+	/*! \brief Resets #L to the bound baseline and puts it back in the pool, releasing it twice is an error */
+	void Release( lua_State* L );
+
+	int NumFree() const { return (int)m_free.size(); }
+	int NumStates() const { return (int)m_states.size(); }
+
+private:
+	struct PooledState
+	{
+		std::vector<char> m_memory;
+		std::unique_ptr<ArenaAllocator> m_allocator;
+		lua_State* m_L;
+		bool m_isFree;		//in m_free
+	};
+
+	PooledState* CreateState();
+
+	size_t m_poolSizeBytes;
+	std::vector<std::unique_ptr<PooledState>> m_states;
+	std::vector<PooledState*> m_free;
+	std::unordered_map<lua_State*, PooledState*> m_byLuaState;
+};
+
+/*! \brief Snapshots the globals, every table they reference & the registry's metatables, so ResetScriptGlobals can put them back */
+void SnapshotScriptGlobals( lua_State* L );
+
+/*! \brief Undo anything a script did to the globals since SnapshotScriptGlobals was called, then a full GC. */
+void ResetScriptGlobals( lua_State* L );
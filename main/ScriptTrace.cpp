@@ -0,0 +1,171 @@
+#include "ScriptTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+std::atomic<bool> g_tracingEnabled( false );
+
+/*! \brief One span or instant, 64 bytes */
+struct TraceEvent
+{
+	uint64_t m_startNs;
+	uint64_t m_durationNs;
+	const char* m_category;
+	char m_name[39];
+	bool m_isInstant;
+};
+
+/*! \brief A thread's ring buffer, only the owning thread writes to it */
+struct ThreadTrace
+{
+	static constexpr uint64_t NUM_EVENTS = 1 << 15;
+
+	std::vector<TraceEvent> m_events;
+	std::atomic<uint64_t> m_numWritten;			//m_numWritten % NUM_EVENTS is the next slot
+	std::string m_threadName;
+	int m_threadIdx;
+
+	explicit ThreadTrace( int threadIdx ) :
+		m_events( NUM_EVENTS ),
+		m_numWritten( 0 ),
+		m_threadIdx( threadIdx )
+	{
+	}
+};
+
+//every thread's buffer, never freed so they can still be dumped after the thread exits
+static std::mutex s_allThreadTracesMutex;
+static std::vector<std::unique_ptr<ThreadTrace>> s_allThreadTraces;
+
+static ThreadTrace& ThisThreadTrace()
+{
+	thread_local ThreadTrace* trace = nullptr;
+	if ( trace == nullptr )
+	{
+		std::lock_guard<std::mutex> lock( s_allThreadTracesMutex );
+		s_allThreadTraces.emplace_back( new ThreadTrace( (int)s_allThreadTraces.size() + 1 ) );
+		trace = s_allThreadTraces.back().get();
+	}
+	return *trace;
+}
+
+static void Record( const char* name, size_t nameLength, const char* category, uint64_t startNs, uint64_t durationNs, bool isInstant )
+{
+	ThreadTrace& trace = ThisThreadTrace();
+	uint64_t numWritten = trace.m_numWritten.load( std::memory_order_relaxed );
+	TraceEvent& event = trace.m_events[numWritten & ( ThreadTrace::NUM_EVENTS - 1 )];
+	event.m_startNs = startNs;
+	event.m_durationNs = durationNs;
+	event.m_category = category;
+	nameLength = std::min( nameLength, sizeof( event.m_name ) - 1 );
+	memcpy( event.m_name, name, nameLength );
+	event.m_name[nameLength] = '\0';
+	event.m_isInstant = isInstant;
+	trace.m_numWritten.store( numWritten + 1, std::memory_order_release );
+}
+
+uint64_t TraceNow()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+void RecordTraceSpan( const char* name, size_t nameLength, const char* category, uint64_t startNs, uint64_t endNs )
+{
+	Record( name, nameLength, category, startNs, endNs - startNs, false );
+}
+
+void RecordTraceInstant( const char* name, const char* category )
+{
+	if ( TracingEnabled() )
+	{
+		Record( name, strlen( name ), category, TraceNow(), 0, true );
+	}
+}
+
+void SetTraceThreadName( const char* name )
+{
+	ThisThreadTrace().m_threadName = name;
+}
+
+/*! \brief Writes #s as a JSON string, names come from scripts so they may need escaping */
+static void WriteJsonString( FILE* f, const char* s )
+{
+	fputc( '"', f );
+	for ( ; *s; s++ )
+	{
+		if ( *s == '"' || *s == '\\' )
+		{
+			fputc( '\\', f );
+			fputc( *s, f );
+		}
+		else if ( (unsigned char)*s < 0x20 )
+		{
+			fprintf( f, "\\u%04x", *s );
+		}
+		else
+		{
+			fputc( *s, f );
+		}
+	}
+	fputc( '"', f );
+}
+
+bool WriteChromeTrace( const char* fileName )
+{
+	FILE* f = fopen( fileName, "w" );
+	if ( f == nullptr )
+	{
+		printf( "unable to open '%s' for writing\n", fileName );
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock( s_allThreadTracesMutex );
+	fprintf( f, "{\"traceEvents\":[\n" );
+	bool first = true;
+	for ( auto& trace : s_allThreadTraces )
+	{
+		if ( trace->m_threadName.empty() == false )
+		{
+			fprintf( f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", trace->m_threadIdx );
+			WriteJsonString( f, trace->m_threadName.c_str() );
+			fprintf( f, "}}" );
+			first = false;
+		}
+
+		uint64_t numWritten = trace->m_numWritten.load( std::memory_order_acquire );
+		uint64_t begin = numWritten > ThreadTrace::NUM_EVENTS ? numWritten - ThreadTrace::NUM_EVENTS : 0;
+		for ( uint64_t i = begin; i < numWritten; i++ )
+		{
+			const TraceEvent& event = trace->m_events[i & ( ThreadTrace::NUM_EVENTS - 1 )];
+			fprintf( f, "%s{\"name\":", first ? "" : ",\n" );
+			WriteJsonString( f, event.m_name );
+			fprintf( f, ",\"cat\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", event.m_category, trace->m_threadIdx, event.m_startNs / 1000.0 );
+			if ( event.m_isInstant )
+			{
+				fprintf( f, ",\"ph\":\"i\",\"s\":\"t\"}" );
+			}
+			else
+			{
+				fprintf( f, ",\"ph\":\"X\",\"dur\":%.3f}", event.m_durationNs / 1000.0 );
+			}
+			first = false;
+		}
+	}
+	fprintf( f, "\n]}\n" );
+	fclose( f );
+	return true;
+}
+
+void ClearTrace()
+{
+	std::lock_guard<std::mutex> lock( s_allThreadTracesMutex );
+	for ( auto& trace : s_allThreadTraces )
+	{
+		trace->m_numWritten.store( 0, std::memory_order_relaxed );
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+// Span recorder for a timeline of script execution, dumped as Chrome trace event JSON
+// that opens in Perfetto or chrome://tracing.
+// Every thread records into its own ring buffer, so recording never takes a lock,
+// once a buffer is full the oldest events are overwritten.
+
+extern std::atomic<bool> g_tracingEnabled;
+
+inline void SetTracingEnabled( bool enabled )
+{
+	g_tracingEnabled.store( enabled, std::memory_order_relaxed );
+}
+
+inline bool TracingEnabled()
+{
+	return g_tracingEnabled.load( std::memory_order_relaxed );
+}
+
+/*! \return a timestamp in nanoseconds for RecordTraceSpan */
+uint64_t TraceNow();
+
+/*! \brief Records a span on this thread, #name is copied (& truncated to 39 characters).
+*	#category must be a string literal, "script", "native", "gc", "alloc"... */
+void RecordTraceSpan( const char* name, size_t nameLength, const char* category, uint64_t startNs, uint64_t endNs );
+
+/*! \brief Records a point in time event on this thread */
+void RecordTraceInstant( const char* name, const char* category );
+
+/*! \brief Names this thread in the trace */
+void SetTraceThreadName( const char* name );
+
+/*! \brief Writes every thread's buffered events as Chrome trace event JSON.
+*	NOTE: call when the other threads aren't recording, an event being written while dumping may come out torn.
+*	\return false if the file couldn't be written */
+bool WriteChromeTrace( const char* fileName );
+
+/*! \brief Empties every thread's buffer, with the same NOTE as WriteChromeTrace */
+void ClearTrace();
+
+/*! \brief Records a span from construction to destruction, if tracing was on when it was made.
+*	NOTE: a Lua error longjmps past the destructor, so an erroring span isn't recorded. */
+class ScopedTraceSpan
+{
+public:
+	ScopedTraceSpan( const char* name, const char* category ) :
+		ScopedTraceSpan( name, TracingEnabled() ? strlen( name ) : 0, category )
+	{
+	}
+
+	ScopedTraceSpan( const char* name, size_t nameLength, const char* category ) :
+		m_name( name ),
+		m_nameLength( nameLength ),
+		m_category( category ),
+		m_startNs( TracingEnabled() ? TraceNow() : 0 )
+	{
+	}
+
+	~ScopedTraceSpan()
+	{
+		if ( m_startNs != 0 )
+		{
+			RecordTraceSpan( m_name, m_nameLength, m_category, m_startNs, TraceNow() );
+		}
+	}
+
+	ScopedTraceSpan( const ScopedTraceSpan& ) = delete;
+	ScopedTraceSpan& operator=( const ScopedTraceSpan& ) = delete;
+
+private:
+	const char* m_name;
+	size_t m_nameLength;
+	const char* m_category;
+	uint64_t m_startNs;
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/*! \brief Refers to a value in a SlotMap. The generation changes every time a slot is reused,
+*	so a handle to a removed value is detected instead of finding whatever replaced it. */
+struct SlotHandle
+{
+	uint32_t index;
+	uint32_t generation;
+
+	bool operator==( const SlotHandle& other ) const { return index == other.index && generation == other.generation; }
+	bool operator!=( const SlotHandle& other ) const { return !( *this == other ); }
+
+	/*! \brief As one number, to hand to Lua as an integer */
+	int64_t ToInteger() const { return ( (int64_t)generation << 32 ) | index; }
+	static SlotHandle FromInteger( int64_t i ) { return { (uint32_t)i, (uint32_t)( (uint64_t)i >> 32 ) }; }
+};
+
+/*! \brief O(1) Insert, Remove & Get by handle, with the values kept packed together for iteration.
+*	Removing swaps the last value into the hole, so the order of iteration changes. */
+template< typename T >
+class SlotMap
+{
+public:
+	SlotHandle Insert( const T& value )
+	{
+		uint32_t slotIdx;
+		if ( m_freeHead != NO_SLOT )
+		{
+			slotIdx = m_freeHead;
+			m_freeHead = m_slots[slotIdx].m_denseIdx;		//the free list is threaded through m_denseIdx
+		}
+		else
+		{
+			slotIdx = (uint32_t)m_slots.size();
+			m_slots.push_back( { 0, 1 } );
+		}
+		Slot& slot = m_slots[slotIdx];
+		slot.m_denseIdx = (uint32_t)m_values.size();
+		m_values.push_back( value );
+		m_denseToSlot.push_back( slotIdx );
+		return { slotIdx, slot.m_generation };
+	}
+
+	/*! \return false if #handle was already removed */
+	bool Remove( SlotHandle handle )
+	{
+		if ( IsValid( handle ) == false )
+		{
+			return false;
+		}
+		Slot& slot = m_slots[handle.index];
+		uint32_t holeIdx = slot.m_denseIdx;
+		uint32_t lastIdx = (uint32_t)m_values.size() - 1;
+		if ( holeIdx != lastIdx )
+		{
+			m_values[holeIdx] = m_values[lastIdx];
+			m_denseToSlot[holeIdx] = m_denseToSlot[lastIdx];
+			m_slots[m_denseToSlot[holeIdx]].m_denseIdx = holeIdx;
+		}
+		m_values.pop_back();
+		m_denseToSlot.pop_back();
+
+		slot.m_generation++;		//invalidates every handle to this slot
+		slot.m_denseIdx = m_freeHead;
+		m_freeHead = handle.index;
+		return true;
+	}
+
+	bool IsValid( SlotHandle handle ) const
+	{
+		return handle.index < m_slots.size() && m_slots[handle.index].m_generation == handle.generation;
+	}
+
+	/*! \return the value, or nullptr if #handle is stale */
+	T* Get( SlotHandle handle )
+	{
+		return IsValid( handle ) ? &m_values[m_slots[handle.index].m_denseIdx] : nullptr;
+	}
+
+	size_t Size() const { return m_values.size(); }
+
+	void Clear()
+	{
+		while ( m_denseToSlot.empty() == false )
+		{
+			uint32_t slotIdx = m_denseToSlot.back();
+			Remove( { slotIdx, m_slots[slotIdx].m_generation } );
+		}
+	}
+
+	// dense iteration
+	T* begin() { return m_values.data(); }
+	T* end() { return m_values.data() + m_values.size(); }
+
+private:
+	static constexpr uint32_t NO_SLOT = 0xffffffffu;
+
+	struct Slot
+	{
+		uint32_t m_denseIdx;		//where the value is in m_values, or the next free slot
+		uint32_t m_generation;		//starts at 1, so a zeroed handle is never valid
+	};
+
+	std::vector<T> m_values;
+	std::vector<uint32_t> m_denseToSlot;
+	std::vector<Slot> m_slots;
+	uint32_t m_freeHead = NO_SLOT;
+};
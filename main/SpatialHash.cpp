@@ -0,0 +1,167 @@
+#include "SpatialHash.h"
+#include <cstdio>
+#include <assert.h>
+
+SpatialHash::SpatialHash( int cellSize ) : m_cellSize( cellSize ), m_count( 0 )
+{
+	assert( cellSize > 0 );
+}
+
+int SpatialHash::CellCoord( int v ) const
+{
+	//round towards -infinity, so -1 isn't in the same cell as 1
+	return v >= 0 ? v / m_cellSize : -( ( -(int64_t)v + m_cellSize - 1 ) / m_cellSize );
+}
+
+uint64_t SpatialHash::CellKey( int cellX, int cellY )
+{
+	return ( (uint64_t)(uint32_t)cellX << 32 ) | (uint32_t)cellY;
+}
+
+void SpatialHash::Insert( SlotHandle id, int x, int y )
+{
+	if ( id.index >= m_locations.size() )
+	{
+		m_locations.resize( id.index + 1, { 0, 0, 0 } );
+	}
+	Location& location = m_locations[id.index];
+	if ( location.generation != 0 )
+	{
+		printf( "SpatialHash::Insert - slot %u is already in the grid\n", id.index );
+		assert( false );
+		return;
+	}
+	location.cellKey = CellKey( CellCoord( x ), CellCoord( y ) );
+	location.generation = id.generation;
+	std::vector<Entry>& cell = m_cells[location.cellKey];
+	location.entryIdx = (uint32_t)cell.size();
+	cell.push_back( { id, x, y } );
+	m_count++;
+}
+
+void SpatialHash::Move( SlotHandle id, int x, int y )
+{
+	if ( id.index >= m_locations.size() || m_locations[id.index].generation != id.generation )
+	{
+		return;		//not in the grid
+	}
+	Location& location = m_locations[id.index];
+	uint64_t cellKey = CellKey( CellCoord( x ), CellCoord( y ) );
+	if ( cellKey == location.cellKey )
+	{
+		Entry& entry = m_cells[cellKey][location.entryIdx];
+		entry.x = x;
+		entry.y = y;
+		return;
+	}
+	RemoveFromCell( location );
+	location.cellKey = cellKey;
+	std::vector<Entry>& cell = m_cells[cellKey];
+	location.entryIdx = (uint32_t)cell.size();
+	cell.push_back( { id, x, y } );
+}
+
+void SpatialHash::Remove( SlotHandle id )
+{
+	if ( id.index >= m_locations.size() || m_locations[id.index].generation != id.generation )
+	{
+		return;
+	}
+	Location& location = m_locations[id.index];
+	RemoveFromCell( location );
+	location.generation = 0;
+	m_count--;
+}
+
+void SpatialHash::RemoveFromCell( const Location& location )
+{
+	auto cellIt = m_cells.find( location.cellKey );
+	assert( cellIt != m_cells.end() );
+	std::vector<Entry>& cell = cellIt->second;
+	if ( location.entryIdx + 1 != cell.size() )
+	{
+		cell[location.entryIdx] = cell.back();
+		m_locations[cell[location.entryIdx].id.index].entryIdx = location.entryIdx;
+	}
+	cell.pop_back();
+	if ( cell.empty() )
+	{
+		m_cells.erase( cellIt );
+	}
+}
+
+void SpatialHash::Clear()
+{
+	m_cells.clear();
+	m_locations.clear();
+	m_count = 0;
+}
+
+template< typename FN >
+void SpatialHash::ForEachInRect( int minX, int minY, int maxX, int maxY, FN fn ) const
+{
+	if ( minX > maxX || minY > maxY )
+	{
+		return;
+	}
+	auto visitCell = [&]( const std::vector<Entry>& cell )
+	{
+		for ( const Entry& entry : cell )
+		{
+			if ( entry.x >= minX && entry.x <= maxX && entry.y >= minY && entry.y <= maxY )
+			{
+				fn( entry );
+			}
+		}
+	};
+
+	int cellMinX = CellCoord( minX ), cellMaxX = CellCoord( maxX );
+	int cellMinY = CellCoord( minY ), cellMaxY = CellCoord( maxY );
+	int64_t numCellsCovered = ( (int64_t)cellMaxX - cellMinX + 1 ) * ( (int64_t)cellMaxY - cellMinY + 1 );
+	if ( numCellsCovered > (int64_t)m_cells.size() )
+	{
+		//a big rect over a sparse grid, cheaper to look at the occupied cells
+		for ( const auto& cell : m_cells )
+		{
+			visitCell( cell.second );
+		}
+		return;
+	}
+	for ( int64_t cellX = cellMinX; cellX <= cellMaxX; cellX++ )
+	{
+		for ( int64_t cellY = cellMinY; cellY <= cellMaxY; cellY++ )
+		{
+			auto cellIt = m_cells.find( CellKey( (int)cellX, (int)cellY ) );
+			if ( cellIt != m_cells.end() )
+			{
+				visitCell( cellIt->second );
+			}
+		}
+	}
+}
+
+void SpatialHash::QueryRect( int minX, int minY, int maxX, int maxY, std::vector<SlotHandle>& results ) const
+{
+	ForEachInRect( minX, minY, maxX, maxY, [&]( const Entry& entry )
+	{
+		results.push_back( entry.id );
+	} );
+}
+
+void SpatialHash::QueryRadius( int x, int y, int radius, std::vector<SlotHandle>& results ) const
+{
+	if ( radius < 0 )
+	{
+		return;
+	}
+	const int64_t radiusSq = (int64_t)radius * radius;
+	ForEachInRect( x - radius, y - radius, x + radius, y + radius, [&]( const Entry& entry )
+	{
+		int64_t dx = (int64_t)entry.x - x;
+		int64_t dy = (int64_t)entry.y - y;
+		if ( dx * dx + dy * dy <= radiusSq )
+		{
+			results.push_back( entry.id );
+		}
+	} );
+}
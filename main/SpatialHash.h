@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "SlotMap.h"
+
+/*! \brief A uniform grid over points, for "what is near here" queries without visiting every point.
+*	Points are identified by the SlotHandle of whatever they belong to, and are kept up to date
+*	one at a time with Move, which only touches the grid when the point changes cell.
+*	Queries append to a caller owned vector, so they don't allocate once it has grown. */
+class SpatialHash
+{
+public:
+	explicit SpatialHash( int cellSize );
+
+	void Insert( SlotHandle id, int x, int y );
+	void Move( SlotHandle id, int x, int y );
+	void Remove( SlotHandle id );
+	void Clear();
+	size_t Count() const { return m_count; }
+
+	/*! \brief Appends every point with minX <= x <= maxX & minY <= y <= maxY to #results */
+	void QueryRect( int minX, int minY, int maxX, int maxY, std::vector<SlotHandle>& results ) const;
+
+	/*! \brief Appends every point within #radius of #x, #y (inclusive) to #results */
+	void QueryRadius( int x, int y, int radius, std::vector<SlotHandle>& results ) const;
+
+private:
+	struct Entry
+	{
+		SlotHandle id;
+		int x;
+		int y;
+	};
+
+	struct Location
+	{
+		uint64_t cellKey;
+		uint32_t generation;	//of the id in this slot, 0 when not in the grid
+		uint32_t entryIdx;		//into the cell
+	};
+
+	int CellCoord( int v ) const;
+	static uint64_t CellKey( int cellX, int cellY );
+	void RemoveFromCell( const Location& location );
+	template< typename FN >
+	void ForEachInRect( int minX, int minY, int maxX, int maxY, FN fn ) const;
+
+	int m_cellSize;
+	size_t m_count;
+	std::unordered_map<uint64_t, std::vector<Entry>> m_cells;
+	std::vector<Location> m_locations;	//by SlotHandle::index
+};
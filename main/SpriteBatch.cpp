@@ -0,0 +1,141 @@
+#include "SpriteBatch.h"
+#include <cstdio>
+#include <assert.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+/*! \brief values[i] += delta[i], 8 or 4 at a time */
+static void AddArrays( int* values, const int* delta, size_t count )
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m256i v = _mm256_loadu_si256( (const __m256i*)( values + i ) );
+		__m256i d = _mm256_loadu_si256( (const __m256i*)( delta + i ) );
+		_mm256_storeu_si256( (__m256i*)( values + i ), _mm256_add_epi32( v, d ) );
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128i v = _mm_loadu_si128( (const __m128i*)( values + i ) );
+		__m128i d = _mm_loadu_si128( (const __m128i*)( delta + i ) );
+		_mm_storeu_si128( (__m128i*)( values + i ), _mm_add_epi32( v, d ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+	{
+		values[i] += delta[i];
+	}
+}
+
+/*! \brief values[i] += delta */
+static void AddScalar( int* values, int delta, size_t count )
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	__m256i d8 = _mm256_set1_epi32( delta );
+	for ( ; i + 8 <= count; i += 8 )
+	{
+		__m256i v = _mm256_loadu_si256( (const __m256i*)( values + i ) );
+		_mm256_storeu_si256( (__m256i*)( values + i ), _mm256_add_epi32( v, d8 ) );
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	__m128i d4 = _mm_set1_epi32( delta );
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		__m128i v = _mm_loadu_si128( (const __m128i*)( values + i ) );
+		_mm_storeu_si128( (__m128i*)( values + i ), _mm_add_epi32( v, d4 ) );
+	}
+#endif
+	for ( ; i < count; i++ )
+	{
+		values[i] += delta;
+	}
+}
+
+int SpriteBatch::Add( int x, int y )
+{
+	m_x.push_back( x );
+	m_y.push_back( y );
+	m_velX.push_back( 0 );
+	m_velY.push_back( 0 );
+	return (int)m_x.size() - 1;
+}
+
+void SpriteBatch::Clear()
+{
+	m_x.clear();
+	m_y.clear();
+	m_velX.clear();
+	m_velY.clear();
+}
+
+int SpriteBatch::Count() const
+{
+	return (int)m_x.size();
+}
+
+bool SpriteBatch::IsValid( int index ) const
+{
+	if ( index < 0 || index >= (int)m_x.size() )
+	{
+		printf( "SpriteBatch index %d out of range, the batch has %d sprites\n", index, (int)m_x.size() );
+		assert( false );
+		return false;
+	}
+	return true;
+}
+
+int SpriteBatch::GetX( int index ) const
+{
+	return IsValid( index ) ? m_x[index] : 0;
+}
+
+int SpriteBatch::GetY( int index ) const
+{
+	return IsValid( index ) ? m_y[index] : 0;
+}
+
+void SpriteBatch::SetPosition( int index, int x, int y )
+{
+	if ( IsValid( index ) )
+	{
+		m_x[index] = x;
+		m_y[index] = y;
+	}
+}
+
+void SpriteBatch::SetVelocity( int index, int velX, int velY )
+{
+	if ( IsValid( index ) )
+	{
+		m_velX[index] = velX;
+		m_velY[index] = velY;
+	}
+}
+
+void SpriteBatch::Move( int index, int velX, int velY )
+{
+	if ( IsValid( index ) )
+	{
+		m_x[index] += velX;
+		m_y[index] += velY;
+	}
+}
+
+void SpriteBatch::MoveAll( int velX, int velY )
+{
+	AddScalar( m_x.data(), velX, m_x.size() );
+	AddScalar( m_y.data(), velY, m_y.size() );
+}
+
+void SpriteBatch::Integrate()
+{
+	AddArrays( m_x.data(), m_velX.data(), m_x.size() );
+	AddArrays( m_y.data(), m_velY.data(), m_y.size() );
+}
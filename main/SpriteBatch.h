@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+
+/*! \brief Sprites stored as structure of arrays, so a whole batch can be moved in one native call
+*	instead of one boxed Sprite & one InvokeFuncOnUserDatum per sprite.
+*	Sprites are referred to by the index Add returns, a plain number in Lua. */
+class SpriteBatch
+{
+public:
+	/*! \return the index of the new sprite */
+	int Add( int x, int y );
+	void Clear();
+	int Count() const;
+
+	int GetX( int index ) const;
+	int GetY( int index ) const;
+	void SetPosition( int index, int x, int y );
+	void SetVelocity( int index, int velX, int velY );
+
+	/*! \brief Moves one sprite */
+	void Move( int index, int velX, int velY );
+
+	/*! \brief Moves every sprite by the same amount */
+	void MoveAll( int velX, int velY );
+
+	/*! \brief Moves every sprite by its own velocity, see SetVelocity */
+	void Integrate();
+
+	const int* X() const { return m_x.data(); }
+	const int* Y() const { return m_y.data(); }
+
+private:
+	bool IsValid( int index ) const;
+
+	std::vector<int> m_x;
+	std::vector<int> m_y;
+	std::vector<int> m_velX;
+	std::vector<int> m_velY;
+};
@@ -0,0 +1,342 @@
+#include "StateImage.h"
+#include "ArenaAllocator.h"
+#include "AutomatedBinding.h"
+#include <cstdio>
+#include <new>
+#include <assert.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000	//older headers, older kernels treat the address as a hint & we check it
+#endif
+#endif
+
+/*! \brief Lives at the start of the arena, so an instance can find its allocator & state */
+struct ImageHeader
+{
+	ArenaAllocator m_allocator;
+	lua_State* m_L;
+
+	ImageHeader( void* begin, void* end ) :
+		m_allocator( begin, end ),
+		m_L( nullptr )
+	{
+	}
+};
+
+StateImage::StateImage() :
+	m_fd( -1 ),
+	m_base( nullptr ),
+	m_size( 0 ),
+	m_instantiated( false )
+{
+}
+
+#if defined(__linux__)
+
+StateImage::~StateImage()
+{
+	assert( m_instantiated == false );	//an instance wasn't released
+	if ( m_fd >= 0 )
+	{
+		close( m_fd );
+	}
+}
+
+/*! \brief Adds the value on the top of the stack to the values still to visit if it can reference others
+*	& hasn't been seen, pops it either way */
+static void QueueValue( lua_State* L, int seenIdx, int pendingIdx, lua_Integer& numPending )
+{
+	int type = lua_type( L, -1 );
+	if ( type != LUA_TTABLE && type != LUA_TUSERDATA && type != LUA_TFUNCTION && type != LUA_TTHREAD )
+	{
+		lua_pop( L, 1 );
+		return;
+	}
+	lua_pushvalue( L, -1 );
+	if ( lua_rawget( L, seenIdx ) != LUA_TNIL )
+	{
+		lua_pop( L, 2 );
+		return;
+	}
+	lua_pop( L, 1 );
+	lua_pushvalue( L, -1 );
+	lua_pushboolean( L, 1 );
+	lua_rawset( L, seenIdx );
+	lua_rawseti( L, pendingIdx, ++numPending );
+}
+
+/*! \brief Queues the locals & functions of every frame of the (suspended) coroutine #thread */
+static void QueueThreadStack( lua_State* L, lua_State* thread, int seenIdx, int pendingIdx, lua_Integer& numPending )
+{
+	lua_Debug ar;
+	for ( int level = 0; lua_getstack( thread, level, &ar ) != 0; level++ )
+	{
+		luaL_checkstack( thread, 2, nullptr );
+		lua_getinfo( thread, "f", &ar );
+		lua_xmove( thread, L, 1 );
+		QueueValue( L, seenIdx, pendingIdx, numPending );
+		for ( int n = 1; lua_getlocal( thread, &ar, n ) != nullptr; n++ )
+		{
+			lua_xmove( thread, L, 1 );
+			QueueValue( L, seenIdx, pendingIdx, numPending );
+		}
+	}
+	int top = lua_gettop( thread );
+	for ( int i = 1; i <= top; i++ )
+	{
+		luaL_checkstack( thread, 1, nullptr );
+		lua_pushvalue( thread, i );
+		lua_xmove( thread, L, 1 );
+		QueueValue( L, seenIdx, pendingIdx, numPending );
+	}
+}
+
+/*! \return true if a userdata with a __gc metamethod can be reached from the registry.
+*	Its finalizer frees native memory outside the arena (e.g. the object behind a bound class's userdata),
+*	which every instance would share, so each instance's lua_close would free it again. */
+static bool HasFinalizedUserdata( lua_State* L )
+{
+	int top = lua_gettop( L );
+	lua_newtable( L );
+	int seenIdx = top + 1;
+	lua_newtable( L );
+	int pendingIdx = top + 2;
+	lua_Integer numPending = 0;
+
+	lua_pushvalue( L, LUA_REGISTRYINDEX );
+	QueueValue( L, seenIdx, pendingIdx, numPending );
+
+	bool found = false;
+	while ( numPending > 0 && found == false )
+	{
+		lua_rawgeti( L, pendingIdx, numPending );
+		lua_pushnil( L );
+		lua_rawseti( L, pendingIdx, numPending-- );
+		int valueIdx = lua_gettop( L );
+		luaL_checkstack( L, 4, nullptr );
+
+		switch ( lua_type( L, valueIdx ) )
+		{
+		case LUA_TTABLE:
+			lua_pushnil( L );
+			while ( lua_next( L, valueIdx ) != 0 )
+			{
+				lua_pushvalue( L, -2 );
+				QueueValue( L, seenIdx, pendingIdx, numPending );	//key
+				QueueValue( L, seenIdx, pendingIdx, numPending );	//value
+			}
+			if ( lua_getmetatable( L, valueIdx ) )
+			{
+				QueueValue( L, seenIdx, pendingIdx, numPending );
+			}
+			break;
+		case LUA_TUSERDATA:
+			if ( luaL_getmetafield( L, valueIdx, "__gc" ) != LUA_TNIL )
+			{
+				found = true;
+				break;
+			}
+			if ( lua_getmetatable( L, valueIdx ) )
+			{
+				QueueValue( L, seenIdx, pendingIdx, numPending );
+			}
+			lua_getuservalue( L, valueIdx );
+			QueueValue( L, seenIdx, pendingIdx, numPending );
+			break;
+		case LUA_TFUNCTION:
+			for ( int i = 1; lua_getupvalue( L, valueIdx, i ) != nullptr; i++ )
+			{
+				QueueValue( L, seenIdx, pendingIdx, numPending );
+			}
+			break;
+		case LUA_TTHREAD:
+			if ( lua_tothread( L, valueIdx ) != L )		//the main thread only has our own stack
+			{
+				QueueThreadStack( L, lua_tothread( L, valueIdx ), seenIdx, pendingIdx, numPending );
+			}
+			break;
+		}
+		lua_settop( L, valueIdx - 1 );
+	}
+
+	lua_settop( L, top );
+	return found;
+}
+
+void* StateImage::MapArena( bool copyOnWrite )
+{
+	int flags = ( copyOnWrite ? MAP_PRIVATE : MAP_SHARED ) | MAP_FIXED_NOREPLACE;
+	void* mapped = mmap( m_base, m_size, PROT_READ | PROT_WRITE, flags, m_fd, 0 );
+	if ( mapped == MAP_FAILED )
+	{
+		return nullptr;
+	}
+	if ( mapped != m_base )
+	{
+		munmap( mapped, m_size );	//someone else is using our address
+		return nullptr;
+	}
+	return mapped;
+}
+
+bool StateImage::Capture( size_t sizeBytes, const char* script, uintptr_t baseAddress )
+{
+	assert( IsCaptured() == false );
+	m_base = (void*)baseAddress;
+	m_size = sizeBytes;
+	m_fd = memfd_create( "lua_state_image", MFD_CLOEXEC );
+	if ( m_fd < 0 || ftruncate( m_fd, (off_t)m_size ) != 0 )
+	{
+		printf( "StateImage: unable to create the memfd\n" );
+		if ( m_fd >= 0 )
+		{
+			close( m_fd );
+			m_fd = -1;
+		}
+		return false;
+	}
+
+	char* arena = (char*)MapArena( false );
+	if ( arena == nullptr )
+	{
+		printf( "StateImage: unable to map the arena at %p\n", m_base );
+		close( m_fd );
+		m_fd = -1;
+		return false;
+	}
+
+	ImageHeader* header = new ( arena ) ImageHeader( arena + sizeof( ImageHeader ), arena + m_size - 1 );
+	header->m_L = CreateScript( header->m_allocator );
+	bool captured = true;
+	if ( LoadScript( header->m_L, script ) != LUA_OK || ExecuteScript( header->m_L ) != LUA_OK )
+	{
+		printf( "StateImage: Error: %s\n", lua_tostring( header->m_L, -1 ) );
+		captured = false;
+	}
+	lua_settop( header->m_L, 0 );
+	lua_gc( header->m_L, LUA_GCCOLLECT, 0 );
+
+	if ( header->m_allocator.m_numFallbackAllocations != 0 )
+	{
+		//those allocations are outside the image & would be shared by every instance
+		printf( "StateImage: the state didn't fit in %d bytes\n", (int)m_size );
+		captured = false;
+	}
+
+	if ( captured && HasFinalizedUserdata( header->m_L ) )
+	{
+		printf( "StateImage: the script left a native object (a userdata with __gc) alive, it can't be shared by instances\n" );
+		captured = false;
+	}
+
+	if ( captured == false )
+	{
+		lua_close( header->m_L );
+		munmap( arena, m_size );
+		close( m_fd );
+		m_fd = -1;
+		return false;
+	}
+
+	//the memfd keeps the image, it is only ever mapped copy-on-write from here on
+	munmap( arena, m_size );
+	return true;
+}
+
+lua_State* StateImage::Instantiate()
+{
+	assert( IsCaptured() );
+	if ( m_instantiated )
+	{
+		return nullptr;
+	}
+	ImageHeader* header = (ImageHeader*)MapArena( true );
+	if ( header == nullptr )
+	{
+		return nullptr;
+	}
+	m_instantiated = true;
+	return header->m_L;
+}
+
+void StateImage::Release( lua_State* L )
+{
+	assert( m_instantiated );
+	ImageHeader* header = (ImageHeader*)m_base;
+	assert( header->m_L == L );
+	lua_close( L );
+	header->m_allocator.~ArenaAllocator();
+	munmap( m_base, m_size );
+	m_instantiated = false;
+}
+
+size_t StateImage::InstancePrivateBytes() const
+{
+	if ( m_instantiated == false )
+	{
+		return 0;
+	}
+
+	FILE* smaps = fopen( "/proc/self/smaps", "r" );
+	if ( smaps == nullptr )
+	{
+		return 0;
+	}
+
+	size_t privateBytes = 0;
+	bool inArena = false;
+	char line[256];
+	while ( fgets( line, sizeof( line ), smaps ) )
+	{
+		unsigned long long start = 0;
+		unsigned long long end = 0;
+		size_t kb = 0;
+		if ( sscanf( line, "%llx-%llx ", &start, &end ) == 2 )
+		{
+			inArena = start == (uintptr_t)m_base;
+		}
+		else if ( inArena && sscanf( line, "Private_Dirty: %zu kB", &kb ) == 1 )
+		{
+			privateBytes = kb * 1024;
+			break;
+		}
+	}
+	fclose( smaps );
+	return privateBytes;
+}
+
+#else
+
+StateImage::~StateImage()
+{
+}
+
+void* StateImage::MapArena( bool )
+{
+	return nullptr;
+}
+
+bool StateImage::Capture( size_t, const char*, uintptr_t )
+{
+	printf( "StateImage: copy-on-write state images need memfd, they are only supported on Linux\n" );
+	return false;
+}
+
+lua_State* StateImage::Instantiate()
+{
+	return nullptr;
+}
+
+void StateImage::Release( lua_State* )
+{
+}
+
+size_t StateImage::InstancePrivateBytes() const
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+#include "lua.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+/*! \brief A prewarmed lua_State (bound & with its scripts already run) whose whole heap lives in one
+*	arena mapped at a fixed address, backed by a memfd.
+*	Instantiate() maps a private copy-on-write view of that arena at the same address, so a new state
+*	is ready without any binding or script execution, and only costs the pages it writes to.
+*	- Linux only, Capture() fails elsewhere.
+*	- Because the address is fixed there can only be one instance per process at a time, run each tenant
+*	  in a fork()'d child (the memfd is inherited) to have many. The image holds pointers to native code
+*	  & rttr data, so it can only be used by this process & its children.
+*	- Nothing in the image can have been allocated outside the arena, Capture() fails if the arena overflowed.
+*	- Nor can the image own native objects, they live on the process heap & every instance's Release() would
+*	  free them again. Capture() fails if the script leaves a userdata with __gc (e.g. a Sprite.new()) alive,
+*	  make those in each instance instead. */
+class StateImage
+{
+public:
+	static constexpr uintptr_t DEFAULT_BASE_ADDRESS = 0x100000000000ull;
+
+	StateImage();
+	~StateImage();
+
+	StateImage( const StateImage& ) = delete;
+	StateImage& operator=( const StateImage& ) = delete;
+
+	/*! \brief Creates a bound state in an arena of #sizeBytes at #baseAddress, runs #script in it and keeps the result as the image
+	*	\return false if the arena couldn't be mapped, #script failed, the state didn't fit in the arena or it kept a native object alive */
+	bool Capture( size_t sizeBytes, const char* script, uintptr_t baseAddress = DEFAULT_BASE_ADDRESS );
+
+	/*! \brief Maps a private copy-on-write instance of the image, nullptr if an instance is already mapped */
+	lua_State* Instantiate();
+
+	/*! \brief Closes the instance (so __gc & native destructors of the objects it made run) and throws away its private pages */
+	void Release( lua_State* L );
+
+	/*! \return the bytes of private (copied) memory the current instance is using */
+	size_t InstancePrivateBytes() const;
+
+	bool IsCaptured() const { return m_fd >= 0; }
+
+private:
+	void* MapArena( bool copyOnWrite );
+
+	int m_fd;
+	void* m_base;
+	size_t m_size;
+	bool m_instantiated;
+};
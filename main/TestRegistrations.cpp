@@ -1,7 +1,33 @@
 #include <rttr/registration>
 #include <cstdio>
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "ArenaAllocator.h"
 #include "AutomatedBinding.h"
+#include "BindingStats.h"
+#include "ConfigSchema.h"
+#include "ContainerView.h"
+#include "PerfCounters.h"
+#include "DeferredDestruction.h"
+#include "DirtyTracking.h"
+#include "NativeBuffer.h"
+#include "NativeVector.h"
+#include "ScriptBudget.h"
+#include "ScriptCompiler.h"
+#include "ScriptExecutor.h"
+#include "ScriptGC.h"
+#include "ScriptProfiler.h"
+#include "ScriptScheduler.h"
+#include "ScriptStatePool.h"
+#include "ScriptTrace.h"
+#include "SpriteBatch.h"
+#include "StateImage.h"
 
 // This Cpp file contains the stuff we are going to 
 //Register with RTTR and will be bound to Lua.
@@ -33,13 +59,25 @@ short Mul(short a, short b)
 	return a * b;
 }
 
+static std::mutex s_slowRequestsMutex;
+static std::vector<std::pair<PendingResult, short>> s_slowRequests;
+
+/*! \brief A slow native operation, the result is given later on a background thread (see AsyncSchedulerTutorial) */
+PendingResult AddLater(short a, short b)
+{
+	PendingResult pending;
+	std::lock_guard<std::mutex> lock(s_slowRequestsMutex);
+	s_slowRequests.push_back({ pending, (short)(a + b) });
+	return pending;
+}
+
 struct Sprite
 {
 	int x;
 	int y;
 
 	Sprite() : x(0), y(0) {}
-	~Sprite() {}
+	virtual ~Sprite() {}
 
 	int Move(int velX, int velY)
 	{
@@ -48,12 +86,133 @@ struct Sprite
 		return x + y;
 	}
 
-	void Draw()
+	void Draw() const
+	{
+		printf("sprite(%p): x = %d, y = %d\n", (const void*)this, x, y);
+	}
+
+	RTTR_ENABLE()
+};
+
+/*! \brief Has all of Sprite's members from Lua as well as its own, see InheritanceTutorial */
+struct AnimatedSprite : Sprite
+{
+	int frame;
+	int numFrames;
+
+	AnimatedSprite() : frame(0), numFrames(4) {}
+
+	void Animate()
+	{
+		frame = (frame + 1) % numFrames;
+	}
+
+	RTTR_ENABLE(Sprite)
+};
+
+/*! \brief Takes any Sprite, an AnimatedSprite included */
+int DistanceSq( Sprite* a, Sprite* b )
+{
+	int dx = a->x - b->x;
+	int dy = a->y - b->y;
+	return dx * dx + dy * dy;
+}
+
+/*! \brief Strings in & out of bound functions, see StringMarshallingTutorial */
+int CountVowels( const char* text )
+{
+	int count = 0;
+	for ( ; *text; text++ )
+	{
+		count += strchr( "aeiouAEIOU", *text ) != nullptr;
+	}
+	return count;
+}
+
+/*! \brief The result points in to #path, a Lua string, pushed back to Lua before that can go */
+rttr::string_view FileExtension( rttr::string_view path )
+{
+	for ( size_t i = path.size(); i > 0; i-- )
+	{
+		if ( path.data()[i - 1] == '.' )
+		{
+			return rttr::string_view( path.data() + i, path.size() - i );
+		}
+	}
+	return rttr::string_view();
+}
+
+std::string Greet( const std::string& name )
+{
+	return "Hello, " + name;
+}
+
+struct Label
+{
+	std::string text;
+
+	void Append( const char* more )
+	{
+		text += more;
+	}
+
+	int Length()
+	{
+		return (int)text.size();
+	}
+};
+
+/*! \brief Filled from a Lua config table, see ConfigTableTutorial */
+struct SpawnPoint
+{
+	int x;
+	int y;
+	std::string kind;
+
+	SpawnPoint() : x(0), y(0) {}
+};
+
+struct LevelConfig
+{
+	std::string name;
+	float gravity;
+	bool wrapAround;
+	SpawnPoint player;
+	std::vector<SpawnPoint> spawns;
+	std::vector<std::string> music;
+
+	LevelConfig() : gravity(0.0f), wrapAround(false) {}
+};
+
+/*! \brief Containers seen from Lua without copying them, see ContainerViewTutorial */
+struct Inventory
+{
+	std::vector<int> counts;
+	std::vector<std::string> items;
+	std::map<std::string, int> prices;
+	std::vector<int> history;		//bound by value, so Lua can only read a copy
+
+	Inventory() : counts{ 3, 1 }, items{ "potion", "sword" }, prices{ { "potion", 5 }, { "sword", 40 } }, history{ 1, 2, 3 } {}
+};
+
+/*! \brief Something with an expensive destructor, lots of small allocations to free */
+struct TextureAtlas
+{
+	std::vector<std::string> m_regionNames;
+
+	TextureAtlas() : m_regionNames( 512, std::string( 64, 'r' ) ) {}
+
+	int NumRegions()
 	{
-		printf("sprite(%p): x = %d, y = %d\n", this, x, y);
+		return (int)m_regionNames.size();
 	}
 };
 
+/*! \brief The same, but registered with DEFERRED_DESTROY */
+struct StreamedTextureAtlas : TextureAtlas
+{
+};
+
 RTTR_REGISTRATION
 {
 	rttr::registration::method("HelloWorld", &HelloWorld);
@@ -61,12 +220,66 @@ RTTR_REGISTRATION
 	rttr::registration::method("HelloWorld3", &HelloWorld3);
 	rttr::registration::method("Add", &Add);
 	rttr::registration::method("Mul", &Mul);
+	rttr::registration::method("AddLater", &AddLater);
+	rttr::registration::method("CountVowels", &CountVowels);
+	rttr::registration::method("FileExtension", &FileExtension);
+	rttr::registration::method("Greet", &Greet);
+	rttr::registration::method("DistanceSq", &DistanceSq);
 	rttr::registration::class_<Sprite>("Sprite")
+		( rttr::metadata( DIRTY_TRACKED, true ) )
 		.constructor()
 		.method("Move", &Sprite::Move)
-		.method("Draw", &Sprite::Draw)
+		.method("Draw", &Sprite::Draw)		//const, so it doesn't mark the sprite dirty
 		.property("x", &Sprite::x)
 		.property("y", &Sprite::y);
+	rttr::registration::class_<AnimatedSprite>("AnimatedSprite")
+		.constructor()
+		.method("Animate", &AnimatedSprite::Animate)
+		.property("frame", &AnimatedSprite::frame)
+		.property("numFrames", &AnimatedSprite::numFrames);
+	rttr::registration::class_<Label>("Label")
+		.constructor()
+		.method("Append", &Label::Append)
+		.method("Length", &Label::Length)
+		.property("text", &Label::text);
+	rttr::registration::class_<SpawnPoint>("SpawnPoint")
+		.constructor()
+		.property("x", &SpawnPoint::x)
+		.property("y", &SpawnPoint::y)
+		.property("kind", &SpawnPoint::kind);
+	rttr::registration::class_<LevelConfig>("LevelConfig")
+		.constructor()
+		.property("name", &LevelConfig::name)
+		.property("gravity", &LevelConfig::gravity)
+		.property("wrapAround", &LevelConfig::wrapAround)
+		.property("player", &LevelConfig::player)
+		.property("spawns", &LevelConfig::spawns)( rttr::policy::prop::bind_as_ptr )	//filled in place, it can be long
+		.property("music", &LevelConfig::music);
+	rttr::registration::class_<Inventory>("Inventory")
+		.constructor()
+		.property("counts", &Inventory::counts)( rttr::policy::prop::bind_as_ptr )
+		.property("items", &Inventory::items)( rttr::policy::prop::bind_as_ptr )
+		.property("prices", &Inventory::prices)( rttr::policy::prop::bind_as_ptr )
+		.property("history", &Inventory::history);
+	rttr::registration::class_<TextureAtlas>("TextureAtlas")
+		.constructor()
+		.method("NumRegions", &TextureAtlas::NumRegions);
+	rttr::registration::class_<StreamedTextureAtlas>("StreamedTextureAtlas")
+		( rttr::metadata( DEFERRED_DESTROY, true ) )
+		.constructor()
+		.method("NumRegions", &StreamedTextureAtlas::NumRegions);
+	rttr::registration::class_<SpriteBatch>("SpriteBatch")
+		.constructor()
+		.method("Add", &SpriteBatch::Add)
+		.method("Clear", &SpriteBatch::Clear)
+		.method("Count", &SpriteBatch::Count)
+		.method("GetX", &SpriteBatch::GetX)
+		.method("GetY", &SpriteBatch::GetY)
+		.method("SetPosition", &SpriteBatch::SetPosition)
+		.method("SetVelocity", &SpriteBatch::SetVelocity)
+		.method("Move", &SpriteBatch::Move)
+		.method("MoveAll", &SpriteBatch::MoveAll)
+		.method("Integrate", &SpriteBatch::Integrate);
 }
 
 /*! \brief The Lua script, you would probably load this data from a .lua file. */
@@ -148,4 +361,1226 @@ void AutomatedBindingTutorial()
 
 	//close the Lua state
 	CloseScript( L );
-}
\ No newline at end of file
+}
+
+/*! \brief Compares loading a few hundred script modules one at a time on the main thread,
+*	against compiling them to bytecode on a worker pool and then just loading the bytecode */
+void ParallelCompileTutorial()
+{
+	printf( "---- parallel background compilation -----\n" );
+
+	constexpr int NUM_MODULES = 400;
+	std::vector<std::string> moduleSources;
+	std::vector<ScriptSource> modules;
+	moduleSources.reserve( NUM_MODULES );
+	for ( int i = 0; i < NUM_MODULES; i++ )
+	{
+		std::string source;
+		for ( int f = 0; f < 20; f++ )
+		{
+			std::string funcName = "Module" + std::to_string( i ) + "_Func" + std::to_string( f );
+			source += "function " + funcName + "( a, b )\n"
+				"	local total = 0\n"
+				"	for i = 1, a do\n"
+				"		if i % 2 == 0 then total = total + i * b else total = total - b end\n"
+				"	end\n"
+				"	local t = { x = a, y = b, z = total }\n"
+				"	return t.x + t.y + t.z\n"
+				"end\n";
+		}
+		moduleSources.push_back( source );
+	}
+	for ( auto& source : moduleSources )
+	{
+		modules.push_back( { "module", source.c_str() } );
+	}
+
+	constexpr int POOL_SIZE = 1024 * 1024;
+	std::vector<char> memory( POOL_SIZE );
+	using Clock = std::chrono::steady_clock;
+
+	//sequential, compile every module on the main thread
+	double sequentialMs = 0;
+	{
+		ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+		lua_State* L = CreateScript( pool );
+		auto start = Clock::now();
+		for ( auto& module : modules )
+		{
+			if ( LoadScript( L, module.source ) != LUA_OK || ExecuteScript( L ) != LUA_OK )
+			{
+				printf( "Error: %s\n", lua_tostring( L, -1 ) );
+				lua_pop( L, 1 );
+			}
+		}
+		sequentialMs = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+		CloseScript( L );
+	}
+
+	//blocking startup step, compile on the worker pool and only lua_load the bytecode on the main thread
+	double parallelMs = 0;
+	{
+		ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+		lua_State* L = CreateScript( pool );
+		auto start = Clock::now();
+		std::vector<CompiledScript> compiled = CompileScripts( modules );
+		for ( auto& script : compiled )
+		{
+			if ( LoadCompiledScript( L, script ) != LUA_OK || ExecuteScript( L ) != LUA_OK )
+			{
+				printf( "Error: %s\n", lua_tostring( L, -1 ) );
+				lua_pop( L, 1 );
+			}
+		}
+		parallelMs = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+		CloseScript( L );
+	}
+
+	//background job, the main thread keeps ticking until the compile has finished
+	{
+		ScriptCompileJob job( modules );
+		int ticks = 0;
+		while ( job.IsFinished() == false )
+		{
+			ticks++;
+			std::this_thread::yield();
+		}
+		printf( "background compile of %d modules finished after %d ticks\n", (int)job.Wait().size(), ticks );
+	}
+
+	printf( "sequential load: %.2fms, parallel compile + bytecode load (%u threads): %.2fms\n",
+		sequentialMs, std::thread::hardware_concurrency(), parallelMs );
+}
+
+/*! \brief Compares creating a fresh bound state for every request, against recycling states from a ScriptStatePool */
+void StatePoolTutorial()
+{
+	printf( "---- recyclable lua_State pool -----\n" );
+
+	constexpr char* REQUEST_SCRIPT = R"(
+		local spr = Sprite.new()
+		spr:Move( 1, 2 )
+		leaked = spr.x			-- globals set by a request must not be seen by the next one
+		Global.Add = nil		-- neither should changes to the bound tables
+		)";
+
+	constexpr int NUM_REQUESTS = 1000;
+	using Clock = std::chrono::steady_clock;
+
+	double createMs = 0;
+	{
+		constexpr int POOL_SIZE = 1024 * 64;
+		std::vector<char> memory( POOL_SIZE );
+		for ( int i = 0; i < NUM_REQUESTS; i++ )
+		{
+			auto start = Clock::now();
+			ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+			lua_State* L = CreateScript( pool );
+			createMs += std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+
+			LoadScript( L, REQUEST_SCRIPT );
+			ExecuteScript( L );
+
+			start = Clock::now();
+			CloseScript( L );
+			createMs += std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+		}
+	}
+
+	double pooledMs = 0;
+	{
+		ScriptStatePool statePool( 4 );
+		for ( int i = 0; i < NUM_REQUESTS; i++ )
+		{
+			auto start = Clock::now();
+			lua_State* L = statePool.Acquire();
+			pooledMs += std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+
+			int leakedType = lua_getglobal( L, "leaked" );
+			assert( leakedType == LUA_TNIL );
+			(void)leakedType;
+			lua_pop( L, 1 );
+			LoadScript( L, REQUEST_SCRIPT );
+			if ( ExecuteScript( L ) != LUA_OK )
+			{
+				printf( "Error: %s\n", lua_tostring( L, -1 ) );
+			}
+
+			start = Clock::now();
+			statePool.Release( L );
+			pooledMs += std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+		}
+	}
+
+	printf( "per request, CreateScript + CloseScript: %.2fus, pool Acquire + Release: %.2fus\n",
+		createMs * 1000.0 / NUM_REQUESTS, pooledMs * 1000.0 / NUM_REQUESTS );
+
+	//more tenants at once than the pool was made with, the extra states are created & join the pool on Release
+	{
+		ScriptStatePool statePool( 2 );
+		std::vector<lua_State*> tenants;
+		for ( int i = 0; i < 5; i++ )
+		{
+			tenants.push_back( statePool.Acquire() );
+		}
+		for ( lua_State* L : tenants )
+		{
+			statePool.Release( L );
+		}
+		assert( statePool.NumFree() == 5 );
+	}
+}
+
+/*! \brief Runs the tutorial script with classes bound on demand, and compares the cost of creating the state */
+void LazyBindingTutorial()
+{
+	printf( "---- lazy class binding -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 64;
+	std::vector<char> memory( POOL_SIZE );
+	using Clock = std::chrono::steady_clock;
+
+	for ( BindingMode mode : { BindingMode::Eager, BindingMode::Lazy } )
+	{
+		ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+		auto start = Clock::now();
+		lua_State* L = CreateScript( pool, mode );
+		double createUs = std::chrono::duration<double, std::micro>( Clock::now() - start ).count();
+		int boundKB = lua_gc( L, LUA_GCCOUNT, 0 );
+
+		LoadScript( L, LUA_SCRIPT );
+		if ( ExecuteScript( L ) != LUA_OK )
+		{
+			printf( "Error: %s\n", lua_tostring( L, -1 ) );
+		}
+		Sprite sprite;
+		CallScriptFunction( L, "Render", sprite );
+
+		printf( "%s binding: CreateScript took %.2fus, %dKB after binding\n",
+			mode == BindingMode::Lazy ? "lazy" : "eager", createUs, boundKB );
+		CloseScript( L );
+	}
+}
+
+/*! \brief Compares making a bound state & running its start up script every time,
+*	against forking a copy-on-write instance of a prewarmed StateImage */
+void StateImageTutorial()
+{
+	printf( "---- copy-on-write prewarmed state images -----\n" );
+
+	constexpr char* PREWARM_SCRIPT = R"(
+		lookup = {}
+		for i = 1, 5000 do
+			lookup[i] = { id = i, name = "item" .. i, cost = i * 3 }
+		end
+
+		function Cost( i )
+			return lookup[i].cost
+		end
+
+		function Update( spr )
+			spr:Move( Cost( 10 ), Cost( 20 ) )
+		end
+		)";
+
+	constexpr int ARENA_SIZE = 1024 * 1024 * 4;
+	constexpr int NUM_STATES = 200;
+	using Clock = std::chrono::steady_clock;
+
+	double freshUs = 0;
+	size_t freshBytes = 0;
+	{
+		std::vector<char> memory( ARENA_SIZE );
+		for ( int i = 0; i < NUM_STATES; i++ )
+		{
+			auto start = Clock::now();
+			ArenaAllocator pool( memory.data(), &memory[ARENA_SIZE - 1] );
+			lua_State* L = CreateScript( pool );
+			LoadScript( L, PREWARM_SCRIPT );
+			ExecuteScript( L );
+			freshUs += std::chrono::duration<double, std::micro>( Clock::now() - start ).count();
+
+			Sprite sprite;
+			CallScriptFunction( L, "Update", sprite );
+			freshBytes = (size_t)( pool.m_curr - (char*)pool.m_begin );
+			CloseScript( L );
+		}
+	}
+
+	StateImage image;
+	if ( image.Capture( ARENA_SIZE, PREWARM_SCRIPT ) == false )
+	{
+		printf( "unable to capture the state image\n" );
+		return;
+	}
+
+	double instanceUs = 0;
+	size_t instanceBytes = 0;
+	for ( int i = 0; i < NUM_STATES; i++ )
+	{
+		auto start = Clock::now();
+		lua_State* L = image.Instantiate();
+		instanceUs += std::chrono::duration<double, std::micro>( Clock::now() - start ).count();
+
+		Sprite sprite;
+		CallScriptFunction( L, "Update", sprite );
+		assert( sprite.x == 30 );
+		instanceBytes = image.InstancePrivateBytes();
+		image.Release( L );
+	}
+
+	//objects an instance makes are its own, each Release() destroys just those
+	for ( int i = 0; i < 2; i++ )
+	{
+		lua_State* L = image.Instantiate();
+		LoadScript( L, "local spr = Sprite.new() spr:Move( Cost( 1 ), Cost( 2 ) ) keep = Sprite.new()" );
+		int status = ExecuteScript( L );
+		assert( status == LUA_OK );
+		(void)status;
+		image.Release( L );
+	}
+
+	//a bound object alive in the image would be destroyed by the Release() of every instance
+	StateImage boundImage;
+	bool capturedBound = boundImage.Capture( ARENA_SIZE, "keep = Sprite.new()" );
+	assert( capturedBound == false );
+	(void)capturedBound;
+
+	printf( "fresh state: %.2fus to create, %dKB of arena used\n", freshUs / NUM_STATES, (int)( freshBytes / 1024 ) );
+	printf( "image instance: %.2fus to create, %dKB of private pages\n", instanceUs / NUM_STATES, (int)( instanceBytes / 1024 ) );
+}
+
+/*! \brief Throughput of a CPU bound Lua job on the ScriptExecutor, from 1 worker up to one per core */
+void ExecutorScalingTutorial()
+{
+	printf( "---- multi-threaded script executor -----\n" );
+
+	constexpr char* WORK_SCRIPT = R"(
+		function Work( n )
+			local total = 0
+			for i = 1, n do
+				total = total + ( i * 7 ) % 13
+			end
+			return total
+		end
+		)";
+
+	constexpr int NUM_SCRIPTS = 16;
+	constexpr int NUM_JOBS = 4000;
+	int iterations = 20000;
+	using Clock = std::chrono::steady_clock;
+
+	const int maxThreads = std::max( 1, (int)std::thread::hardware_concurrency() );
+	double singleThreadJobsPerSec = 0;
+	for ( int numThreads = 1; ; numThreads = std::min( numThreads * 2, maxThreads ) )
+	{
+		ScriptExecutor executor( numThreads );
+		for ( int i = 0; i < NUM_SCRIPTS; i++ )
+		{
+			executor.AddScript( WORK_SCRIPT );
+		}
+
+		auto start = Clock::now();
+		for ( int i = 0; i < NUM_JOBS; i++ )
+		{
+			executor.Submit( { i % NUM_SCRIPTS, "Work", { iterations } } );
+		}
+		executor.WaitIdle();
+		double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+		double jobsPerSec = NUM_JOBS / seconds;
+		if ( numThreads == 1 )
+		{
+			singleThreadJobsPerSec = jobsPerSec;
+		}
+		printf( "%2d threads: %.0f jobs/s, %.2fx, %d stolen\n",
+			numThreads, jobsPerSec, jobsPerSec / singleThreadJobsPerSec, (int)executor.NumJobsStolen() );
+
+		if ( numThreads == maxThreads )
+		{
+			break;
+		}
+	}
+}
+
+/*! \brief Thousands of script tasks waiting on a slow native operation, sharing one lua_State & thread */
+void AsyncSchedulerTutorial()
+{
+	printf( "---- coroutine scheduler for scripts awaiting native operations -----\n" );
+
+	constexpr char* TASK_SCRIPT = R"(
+		completed = 0
+		total = 0
+		function Task( i )
+			local a = Global.AddLater( i, 1 )	-- the coroutine yields here until the result is ready
+			local b = Global.AddLater( a, 1 )
+			total = total + b
+			completed = completed + 1
+		end
+		)";
+
+	constexpr int POOL_SIZE = 1024 * 1024;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	LoadScript( L, TASK_SCRIPT );
+	ExecuteScript( L );
+
+	//the slow native side, completes everything that was asked for about once a millisecond
+	std::atomic<bool> serviceRunning( true );
+	std::thread service( [&serviceRunning]()
+	{
+		while ( serviceRunning )
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+			std::vector<std::pair<PendingResult, short>> requests;
+			{
+				std::lock_guard<std::mutex> lock( s_slowRequestsMutex );
+				requests.swap( s_slowRequests );
+			}
+			for ( auto& request : requests )
+			{
+				request.first.Complete( request.second );
+			}
+		}
+	} );
+
+	constexpr int NUM_TASKS = 5000;
+	int numTicks = 0;
+	{
+		ScriptScheduler scheduler( L );
+		for ( int i = 0; i < NUM_TASKS; i++ )
+		{
+			scheduler.Spawn( "Task", { (short)( i % 1000 ) } );
+		}
+		printf( "%d tasks in flight\n", scheduler.NumWaiting() );
+
+		while ( scheduler.NumWaiting() > 0 )
+		{
+			scheduler.Tick();
+			numTicks++;
+			std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+		}
+		printf( "all tasks finished after %d ticks, using %d coroutine threads (%d pooled for reuse)\n",
+			numTicks, scheduler.NumThreadsCreated(), scheduler.NumPooledThreads() );
+	}
+
+	serviceRunning = false;
+	service.join();
+
+	lua_getglobal( L, "completed" );
+	printf( "completed = %d, memory used = %dKB\n", (int)lua_tonumber( L, -1 ), lua_gc( L, LUA_GCCOUNT, 0 ) );
+	CloseScript( L );
+}
+
+/*! \brief Aborting a runaway script, time slicing a long one, and the cost of the budget hook */
+void ScriptBudgetTutorial()
+{
+	printf( "---- instruction/time budgets -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 256;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	using Clock = std::chrono::steady_clock;
+
+	//abort
+	{
+		ScriptBudget budget;
+		budget.maxMilliseconds = 5;
+		LoadScript( L, "while true do end" );
+		int result = ExecuteScriptBudgeted( L, budget );
+		printf( "runaway script: %s (%s)\n", result == SCRIPT_ERRBUDGET ? "aborted" : "not aborted!", lua_tostring( L, -1 ) );
+		lua_settop( L, 0 );
+	}
+
+	//nor can a script catch the abort with pcall, or run away in a coroutine of its own
+	{
+		luaL_requiref( L, "_G", luaopen_base, 1 );
+		luaL_requiref( L, "coroutine", luaopen_coroutine, 1 );
+		lua_settop( L, 0 );
+		const char* ESCAPES[] = {
+			"while true do pcall( function() while true do end end ) end",
+			"coroutine.wrap( function() while true do end end )()",
+		};
+		ScriptBudget budget;
+		budget.maxMilliseconds = 5;
+		for ( const char* escape : ESCAPES )
+		{
+			LoadScript( L, escape );
+			int result = ExecuteScriptBudgeted( L, budget );
+			printf( "'%s': %s\n", escape, result == SCRIPT_ERRBUDGET ? "aborted" : "not aborted!" );
+			assert( result == SCRIPT_ERRBUDGET );
+			lua_settop( L, 0 );
+		}
+	}
+
+	constexpr char* LONG_JOB = R"(
+		function LongJob( n )
+			local total = 0
+			for i = 1, n do
+				total = total + i % 3
+			end
+			return total
+		end
+		)";
+	LoadScript( L, LONG_JOB );
+	ExecuteScript( L );
+
+	//time slice, 1ms per tick
+	{
+		lua_State* co = lua_newthread( L );
+		lua_getglobal( co, "LongJob" );
+		lua_pushnumber( co, 20000000 );
+		ScriptBudget slice;
+		slice.maxMilliseconds = 1;
+		int numTicks = 1;
+		int numArgs = 1;
+		bool budgetExceeded = false;
+		while ( ResumeScriptBudgeted( co, L, numArgs, slice, &budgetExceeded ) == LUA_YIELD && budgetExceeded )
+		{
+			numArgs = 0;
+			numTicks++;
+		}
+		printf( "long job finished over %d ticks, result = %.0f\n", numTicks, lua_tonumber( co, -1 ) );
+		lua_pop( L, 1 );	//the thread
+	}
+
+	//overhead of the hook when the budget is never reached
+	{
+		constexpr int NUM_RUNS = 20;
+		ScriptBudget generous;
+		generous.maxMilliseconds = 1000 * 60;
+		double plainMs = 0;
+		double hookedMs = 0;
+		for ( int i = 0; i < NUM_RUNS; i++ )
+		{
+			LoadScript( L, "LongJob( 1000000 )" );
+			auto start = Clock::now();
+			ExecuteScript( L );
+			plainMs += std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+
+			LoadScript( L, "LongJob( 1000000 )" );
+			start = Clock::now();
+			ExecuteScriptBudgeted( L, generous );
+			hookedMs += std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+		}
+		printf( "budget hook overhead: %.2fms without, %.2fms with (%.1f%%)\n",
+			plainMs / NUM_RUNS, hookedMs / NUM_RUNS, ( hookedMs - plainMs ) * 100.0 / plainMs );
+	}
+
+	CloseScript( L );
+}
+
+/*! \brief Update frame times with Lua's automatic gc, against stepping the gc in the idle time left in each frame */
+void GcSchedulerTutorial()
+{
+	printf( "---- frame budgeted gc -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 1024 * 4;
+	constexpr int NUM_FRAMES = 2000;
+	constexpr char* GARBAGE_MAKER = R"(
+		function Update()
+			local t = {}
+			for i = 1, 200 do
+				t[i] = { x = i, y = i * 2 }
+			end
+			return t[1].x
+		end
+		)";
+	using Clock = std::chrono::steady_clock;
+
+	auto runFrames = [&]( bool scheduled )
+	{
+		std::vector<char> memory( POOL_SIZE );
+		ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+		lua_State* L = CreateScript( pool );
+		LoadScript( L, GARBAGE_MAKER );
+		ExecuteScript( L );
+
+		ScriptGC gc( L, &pool );
+		if ( scheduled )
+		{
+			gc.SetIncrementalParams( 200, 200 );
+			gc.SetAutomatic( false );
+		}
+
+		LatencyHistogram callTimes;
+		for ( int frame = 0; frame < NUM_FRAMES; frame++ )
+		{
+			auto start = Clock::now();
+			CallScriptFunction( L, "Update" );
+			callTimes.Record( std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - start ).count() );
+
+			if ( scheduled )
+			{
+				gc.Step( 100 );		//the idle time left in the frame
+			}
+		}
+		printf( "%s gc, Update: mean %.1fus, p99 <%.1fus, max %.1fus\n", scheduled ? "scheduled" : "automatic",
+			callTimes.MeanNs() / 1000.0, callTimes.PercentileNs( 99 ) / 1000.0, callTimes.MaxNs() / 1000.0 );
+		if ( scheduled )
+		{
+			gc.PrintStats( "scheduled" );
+		}
+		CloseScript( L );
+	};
+
+	runFrames( false );
+	runFrames( true );
+}
+
+/*! \brief The gc pause when an expensive native destructor runs inside __gc, against queuing it for the destructor thread */
+void DeferredDestructionTutorial()
+{
+	printf( "---- deferred destructors -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 1024;
+	constexpr int NUM_FRAMES = 50;
+	constexpr char* MAKE_ATLASES = R"(
+		function MakeAtlases( className )
+			for i = 1, 100 do
+				local atlas = _ENV[className].new()
+				atlas:NumRegions()
+			end
+		end
+		)";
+
+	auto runFrames = [&]( const char* className )
+	{
+		std::vector<char> memory( POOL_SIZE );
+		ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+		lua_State* L = CreateScript( pool );
+		LoadScript( L, MAKE_ATLASES );
+		ExecuteScript( L );
+
+		ScriptGC gc( L, &pool );
+		gc.SetAutomatic( false );
+		for ( int frame = 0; frame < NUM_FRAMES; frame++ )
+		{
+			lua_getglobal( L, "MakeAtlases" );
+			lua_pushstring( L, className );
+			if ( lua_pcall( L, 1, 0, 0 ) != LUA_OK )
+			{
+				printf( "MakeAtlases failed '%s'\n", lua_tostring( L, -1 ) );
+				lua_pop( L, 1 );
+			}
+			gc.FullCollect();
+		}
+		printf( "%s: gc pause mean %.1fus, max %.1fus, %d destructors still queued\n", className,
+			gc.CycleTimes().MeanNs() / 1000.0, gc.CycleTimes().MaxNs() / 1000.0, NumDeferredDestructions() );
+		CloseScript( L );
+	};
+
+	StartDestructorThread();
+	runFrames( "TextureAtlas" );
+	runFrames( "StreamedTextureAtlas" );
+	StopDestructorThread();
+	assert( NumDeferredDestructions() == 0 );
+}
+
+/*! \brief Samples a game loop's script call stacks and writes them out in folded form for a flame graph */
+void ProfilerTutorial()
+{
+	printf( "---- sampling profiler -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 256;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	constexpr char* GAME_LOOP = R"(
+		function Physics( spr )
+			local total = 0
+			for i = 1, 2000 do
+				total = total + spr:Move( 1, -1 )
+			end
+			return total
+		end
+
+		function Ai()
+			local total = 0
+			for i = 1, 20000 do
+				total = total + i % 7
+			end
+			return total
+		end
+
+		function Update( spr )
+			Physics( spr )
+			Ai()
+		end
+		)";
+	LoadScript( L, GAME_LOOP );
+	ExecuteScript( L );
+
+	Sprite sprite;
+	ScriptProfiler profiler( L, ProfilerClock::Timer, 100 );
+	profiler.Start();
+	for ( int frame = 0; frame < 200; frame++ )
+	{
+		CallScriptFunction( L, "Update", sprite );
+	}
+	profiler.Stop();
+
+	//frames run without the profiler aren't sampled
+	CallScriptFunction( L, "Update", sprite );
+
+	const char* PROFILE_FILE = "LuaTutorial.folded";
+	if ( profiler.WriteFoldedStacks( PROFILE_FILE ) )
+	{
+		printf( "%d samples written to %s, view with flamegraph.pl or speedscope\n", profiler.NumSamples(), PROFILE_FILE );
+	}
+	CloseScript( L );
+}
+
+/*! \brief Counts & times the calls across the binding, read from C++ and from Lua */
+void BindingStatsTutorial()
+{
+	printf( "---- binding stats -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 256;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	constexpr char* HOT_LOOP = R"(
+		function Update( spr )
+			local total = 0
+			for i = 1, 1000 do
+				total = total + Global.Add( i, 1 ) + spr:Move( 1, 1 )
+			end
+			return total
+		end
+
+		function MoveCalls()
+			return Global.BindingStats()["Sprite.Move"].calls
+		end
+		)";
+	LoadScript( L, HOT_LOOP );
+	ExecuteScript( L );
+
+	Sprite sprite;
+	CallScriptFunction( L, "Update", sprite );		//not recorded
+
+	SetBindingStatsEnabled( true );
+	for ( int frame = 0; frame < 100; frame++ )
+	{
+		CallScriptFunction( L, "Update", sprite );
+	}
+	SetBindingStatsEnabled( false );
+	PrintBindingStats();
+
+	lua_getglobal( L, "MoveCalls" );
+	if ( lua_pcall( L, 0, 1, 0 ) == LUA_OK )
+	{
+		printf( "from Lua, Sprite.Move calls = %d\n", (int)lua_tointeger( L, -1 ) );
+	}
+	lua_pop( L, 1 );
+	CloseScript( L );
+}
+
+/*! \brief Writes a chrome trace of script calls, gc steps & fallback allocations on the main thread and the executor's workers */
+void TraceTutorial()
+{
+	printf( "---- chrome trace -----\n" );
+
+	SetTraceThreadName( "main" );
+	SetTracingEnabled( true );
+
+	//a tick on the main thread
+	{
+		constexpr int POOL_SIZE = 1024 * 64;	//small, so some allocations fall back
+		std::vector<char> memory( POOL_SIZE );
+		ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+		lua_State* L = CreateScript( pool );
+		LoadScript( L, R"(
+			function Update( spr )
+				local t = {}
+				for i = 1, 100 do
+					t[i] = { spr:Move( 1, 1 ), Global.Add( i, 2 ) }
+				end
+			end
+			)" );
+		ExecuteScript( L );
+
+		ScriptGC gc( L, &pool );
+		gc.SetAutomatic( false );
+		Sprite sprite;
+		for ( int frame = 0; frame < 10; frame++ )
+		{
+			CallScriptFunction( L, "Update", sprite );
+			gc.Step( 50 );
+		}
+		CloseScript( L );
+	}
+
+	//interleaving across worker threads
+	{
+		ScriptExecutor executor( 4 );
+		for ( int i = 0; i < 4; i++ )
+		{
+			executor.AddScript( "function Work( n ) local total = 0 for i = 1, n do total = total + Global.Add( i % 100, 1 ) end end" );
+		}
+		for ( int i = 0; i < 32; i++ )
+		{
+			executor.Submit( { i % 4, "Work", { 1000 + i * 100 } } );
+		}
+		executor.WaitIdle();
+	}
+
+	SetTracingEnabled( false );
+	const char* TRACE_FILE = "LuaTutorial.trace.json";
+	if ( WriteChromeTrace( TRACE_FILE ) )
+	{
+		printf( "trace written to %s, open it in https://ui.perfetto.dev or chrome://tracing\n", TRACE_FILE );
+	}
+}
+
+/*! \brief Hardware performance counters (or just the clock) around arithmetic & table heavy script functions */
+void PerfCountersTutorial()
+{
+	printf( "---- hardware performance counters -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 256;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+
+	SetPerfCountersEnabled( true );
+	LoadScript( L, R"(
+		function Arithmetic()
+			local total = 0
+			for i = 1, 100000 do
+				total = total + i % 7
+			end
+		end
+
+		function TableChurn()
+			local t = {}
+			for i = 1, 10000 do
+				t[( i * 7919 ) % 10000] = { i }
+			end
+		end
+		)" );
+	ExecuteScript( L );
+	for ( int i = 0; i < 20; i++ )
+	{
+		CallScriptFunction( L, "Arithmetic" );
+		CallScriptFunction( L, "TableChurn" );
+	}
+	SetPerfCountersEnabled( false );
+
+	printf( "hardware counters: %s\n", HasHardwareCounters() ? "yes" : "no, clock only" );
+	PrintBindingStats();
+	CloseScript( L );
+}
+
+/*! \brief Lua working on a typed array in C++ memory with no copying, compared with the same work on a table */
+void NativeBufferTutorial()
+{
+	printf( "---- native buffers -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 1024 * 4;
+	constexpr int NUM_SAMPLES = 100000;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	OpenNativeBuffers( L );
+	using Clock = std::chrono::steady_clock;
+
+	LoadScript( L, R"(
+		function Normalise( samples )
+			local total = samples:sum()
+			samples:scale( 1 / total )
+			return samples:max(), samples[1], #samples
+		end
+
+		function NormaliseTable( samples, n )
+			local total = 0
+			for i = 1, n do
+				total = total + samples[i]
+			end
+			local maxValue = samples[1] / total
+			for i = 1, n do
+				samples[i] = samples[i] / total
+				if samples[i] > maxValue then maxValue = samples[i] end
+			end
+			return maxValue
+		end
+
+		function MakeTable( n )
+			local t = {}
+			for i = 1, n do
+				t[i] = i
+			end
+			return t
+		end
+
+		function Energy()
+			local a = Buffer.new( "double", 8 )
+			a:fill( 0.5 )
+			a[8] = 2
+			local firstHalf = a:view( 1, 4 )
+			return a:dot( a ), firstHalf:sum(), a:type()
+		end
+		)" );
+	ExecuteScript( L );
+
+	//zero copy over C++ memory
+	std::vector<float> samples( NUM_SAMPLES );
+	for ( int i = 0; i < NUM_SAMPLES; i++ )
+	{
+		samples[i] = (float)( i + 1 );
+	}
+	auto start = Clock::now();
+	lua_getglobal( L, "Normalise" );
+	PushNativeBufferView( L, samples.data(), samples.size() );
+	lua_pcall( L, 1, 3, 0 );
+	double bufferMs = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+	printf( "buffer: max %f, first %g, length %d, C++ sees samples[0] = %g\n",
+		lua_tonumber( L, -3 ), lua_tonumber( L, -2 ), (int)lua_tointeger( L, -1 ), samples[0] );
+	lua_pop( L, 3 );
+
+	//the same work element by element on a table
+	lua_getglobal( L, "MakeTable" );
+	lua_pushinteger( L, NUM_SAMPLES );
+	lua_pcall( L, 1, 1, 0 );
+	int tableIdx = lua_gettop( L );
+	start = Clock::now();
+	lua_getglobal( L, "NormaliseTable" );
+	lua_pushvalue( L, tableIdx );
+	lua_pushinteger( L, NUM_SAMPLES );
+	lua_pcall( L, 2, 1, 0 );
+	double tableMs = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+	printf( "normalise %d samples: buffer %.3fms, table %.3fms\n", NUM_SAMPLES, bufferMs, tableMs );
+	lua_settop( L, 0 );
+
+	lua_getglobal( L, "Energy" );
+	if ( lua_pcall( L, 0, 3, 0 ) == LUA_OK )
+	{
+		printf( "dot %g, view sum %g, type %s\n", lua_tonumber( L, -3 ), lua_tonumber( L, -2 ), lua_tostring( L, -1 ) );
+	}
+	lua_settop( L, 0 );
+	CloseScript( L );
+}
+
+/*! \brief A script changes a few of 1000 sprites each frame, and the native side visits just those */
+void DirtyTrackingTutorial()
+{
+	printf( "---- dirty tracking -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 1024;
+	constexpr int NUM_FRAMES = 3;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	LoadScript( L, R"(
+		sprites = {}
+		for i = 1, 1000 do
+			sprites[i] = Sprite.new()
+		end
+
+		function Update( frame )
+			-- only a few sprites change each frame
+			for i = frame, 1000, 100 do
+				sprites[i]:Move( 1, 0 )
+			end
+			sprites[1].y = frame
+			sprites[2]:Draw()		-- doesn't make it dirty
+		end
+		)" );
+	ExecuteScript( L );
+	ClearDirtyObjects( L );		//making them isn't a change
+
+	for ( int frame = 1; frame <= NUM_FRAMES; frame++ )
+	{
+		CallScriptFunction( L, "Update", frame );
+
+		//the native side only visits what changed, not all 1000
+		//(through the property, the variant may hold the Sprite by value or by pointer depending on the constructor policy)
+		static const rttr::property xProperty = rttr::type::get<Sprite>().get_property( "x" );
+		int sumX = 0;
+		for ( UserDatum* ud : DirtyObjects( L ) )
+		{
+			sumX += xProperty.get_value( ud->m_object ).get_value<int>();
+		}
+		printf( "frame %d: %d of 1000 sprites dirty, sum of their x = %d\n", frame, (int)DirtyObjects( L ).size(), sumX );
+		ClearDirtyObjects( L );
+	}
+	CloseScript( L );
+}
+
+/*! \brief Vector maths on SIMD Vec2/Vec3/Vec4 userdata, and the garbage the in-place & scratch variants save */
+void NativeVectorTutorial()
+{
+	printf( "---- native vectors -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 1024 * 4;
+	constexpr int NUM_STEPS = 10000;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	OpenNativeVectors( L );
+
+	LoadScript( L, R"(
+		position = Vec3.new( 0, 10, 0 )
+		velocity = Vec3.new( 1, 0, 0 )
+		gravity = Vec3.new( 0, -9.8, 0 )
+
+		function Step( n, dt )
+			for i = 1, n do
+				velocity = velocity + gravity * dt
+				position = position + velocity * dt
+			end
+		end
+
+		function StepInPlace( n, dt )
+			for i = 1, n do
+				velocity:addInPlace( Vec3.temp():copy( gravity ):mulInPlace( dt ) )
+				position:addInPlace( Vec3.temp():copy( velocity ):mulInPlace( dt ) )
+			end
+		end
+
+		function Check()
+			local a = Vec2.new( 1, 2 )
+			local b = Vec2.new( 3, 4 )
+			return a:dot( b ), -a == Vec2.new( -1, -2 ), ( 2 * a + b ).y
+		end
+		)" );
+	ExecuteScript( L );
+
+	lua_getglobal( L, "Check" );
+	if ( lua_pcall( L, 0, 3, 0 ) == LUA_OK )
+	{
+		printf( "dot %g, -a == (-1, -2) %s, (2a + b).y = %g\n",
+			lua_tonumber( L, -3 ), lua_toboolean( L, -2 ) ? "true" : "false", lua_tonumber( L, -1 ) );
+	}
+	lua_settop( L, 0 );
+
+	//how much garbage each way makes, with the collector stopped
+	lua_gc( L, LUA_GCCOLLECT, 0 );
+	lua_gc( L, LUA_GCSTOP, 0 );
+	for ( const char* step : { "Step", "StepInPlace" } )
+	{
+		int kbBefore = lua_gc( L, LUA_GCCOUNT, 0 );
+		lua_getglobal( L, step );
+		lua_pushinteger( L, NUM_STEPS );
+		lua_pushnumber( L, 1.0 / 60.0 );
+		if ( lua_pcall( L, 2, 0, 0 ) != LUA_OK )
+		{
+			printf( "%s failed '%s'\n", step, lua_tostring( L, -1 ) );
+			lua_pop( L, 1 );
+		}
+		printf( "%s: %d steps made %dKB of garbage\n", step, NUM_STEPS, lua_gc( L, LUA_GCCOUNT, 0 ) - kbBefore );
+		lua_gc( L, LUA_GCCOLLECT, 0 );
+	}
+	lua_gc( L, LUA_GCRESTART, 0 );
+	CloseScript( L );
+}
+
+/*! \brief std::string arguments, returns & properties passed across the binding */
+void StringMarshallingTutorial()
+{
+	printf( "---- strings -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 256;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	LoadScript( L, R"(
+		function Strings()
+			local label = Label.new()
+			label.text = Global.Greet( "Lua" )
+			label:Append( "!" )
+			return Global.CountVowels( "embedding lua" ), Global.FileExtension( "sprites/hero.png" ), label.text, label:Length()
+		end
+		)" );
+	ExecuteScript( L );
+
+	lua_getglobal( L, "Strings" );
+	if ( lua_pcall( L, 0, 4, 0 ) == LUA_OK )
+	{
+		printf( "vowels %d, extension '%s', label '%s' (%d)\n",
+			(int)lua_tointeger( L, -4 ), lua_tostring( L, -3 ), lua_tostring( L, -2 ), (int)lua_tointeger( L, -1 ) );
+	}
+	else
+	{
+		printf( "Strings failed '%s'\n", lua_tostring( L, -1 ) );
+	}
+	lua_settop( L, 0 );
+	CloseScript( L );
+}
+
+/*! \brief Loads a Lua config table in to a native struct in one pass, and hands it back to Lua as a table */
+void ConfigTableTutorial()
+{
+	printf( "---- config tables -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 256;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	LoadScript( L, R"(
+		Level = {
+			name = "Caves",
+			gravity = 9.8,
+			wrapAround = true,
+			player = { x = 16, y = 32 },
+			spawns = {
+				{ x = 100, y = 40, kind = "bat" },
+				{ x = 220, y = 40, kind = "bat" },
+				{ x = 300, y = 96, kind = "slime" },
+			},
+			music = { "drip.ogg", "wind.ogg" },
+		}
+
+		function Describe( level )
+			local last = level.spawns[#level.spawns]
+			return level.name, #level.spawns, last.kind, last.x
+		end
+		)" );
+	ExecuteScript( L );
+
+	//one pass over the table, instead of a lua_getfield per field
+	LevelConfig level;
+	lua_getglobal( L, "Level" );
+	bool ok = TableToObject( L, -1, level );
+	lua_pop( L, 1 );
+	printf( "%s: '%s' gravity %.1f, player at %d,%d, %d spawns, %d tracks\n", ok ? "loaded" : "loaded with errors",
+		level.name.c_str(), level.gravity, level.player.x, level.player.y, (int)level.spawns.size(), (int)level.music.size() );
+	for ( const SpawnPoint& spawn : level.spawns )
+	{
+		printf( "\t%s at %d,%d\n", spawn.kind.c_str(), spawn.x, spawn.y );
+	}
+
+	//and back, e.g. to hand an edited level to an editor script
+	SpawnPoint boss;
+	boss.x = 480;
+	boss.y = 64;
+	boss.kind = "dragon";
+	level.name += " (edited)";
+	level.spawns.push_back( boss );
+	lua_getglobal( L, "Describe" );
+	PushObjectAsTable( L, level );
+	if ( lua_pcall( L, 1, 4, 0 ) == LUA_OK )
+	{
+		printf( "Lua sees '%s' with %d spawns, the last a %s at x %d\n",
+			lua_tostring( L, -4 ), (int)lua_tointeger( L, -3 ), lua_tostring( L, -2 ), (int)lua_tointeger( L, -1 ) );
+	}
+	else
+	{
+		printf( "Describe failed '%s'\n", lua_tostring( L, -1 ) );
+	}
+	lua_settop( L, 0 );
+
+	//mistakes in the config are reported, the rest of it is still loaded
+	LoadScript( L, R"(
+		Typo = { name = "Typo", gravty = 1, player = { x = "left" } }
+		)" );
+	ExecuteScript( L );
+	LevelConfig typo;
+	lua_getglobal( L, "Typo" );
+	ok = TableToObject( L, -1, typo );
+	lua_pop( L, 1 );
+	printf( "Typo loaded %s, name '%s'\n", ok ? "cleanly" : "with errors", typo.name.c_str() );
+	CloseScript( L );
+}
+
+/*! \brief A script reading & writing std::vector and std::map properties in place, through container views */
+void ContainerViewTutorial()
+{
+	printf( "---- container views -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 256;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	luaL_requiref( L, "_G", luaopen_base, 1 );	//for pairs, ipairs & pcall
+	lua_pop( L, 1 );
+	LoadScript( L, R"(
+		function Restock( inv )
+			local counts = inv.counts		-- a view of the native vector, keep it in a local rather than looking it up again
+			for i, count in ipairs( counts ) do
+				counts[i] = count + 10
+			end
+			inv.items[#inv.items + 1] = "shield"
+			counts[#counts + 1] = 1
+			inv.prices["shield"] = 25
+			inv.prices["potion"] = nil
+
+			local total = 0
+			for item, price in pairs( inv.prices ) do
+				total = total + price
+			end
+			local canWrite = pcall( function() inv.history[1] = 0 end )
+			return #inv.items, total, #inv.history, canWrite
+		end
+		)" );
+	ExecuteScript( L );
+
+	Inventory inventory;
+	lua_getglobal( L, "Restock" );
+	rttr::variant inventoryPtr( &inventory );
+	ToLua( L, inventoryPtr );
+	if ( lua_pcall( L, 1, 4, 0 ) == LUA_OK )
+	{
+		printf( "Lua sees %d items, prices totalling %d, %d history entries (%s)\n", (int)lua_tointeger( L, -4 ), (int)lua_tointeger( L, -3 ),
+			(int)lua_tointeger( L, -2 ), lua_toboolean( L, -1 ) ? "written" : "read only" );
+	}
+	else
+	{
+		printf( "Restock failed '%s'\n", lua_tostring( L, -1 ) );
+	}
+	lua_settop( L, 0 );
+
+	//the script changed the native containers
+	for ( size_t i = 0; i < inventory.items.size(); i++ )
+	{
+		int count = i < inventory.counts.size() ? inventory.counts[i] : 0;
+		auto price = inventory.prices.find( inventory.items[i] );
+		printf( "\t%s x%d, price %d\n", inventory.items[i].c_str(), count, price != inventory.prices.end() ? price->second : 0 );
+	}
+	CloseScript( L );
+}
+
+/*! \brief Inherited members, IsA checks and passing a derived object where its base class is expected */
+void InheritanceTutorial()
+{
+	printf( "---- inheritance -----\n" );
+
+	constexpr int POOL_SIZE = 1024 * 256;
+	std::vector<char> memory( POOL_SIZE );
+	ArenaAllocator pool( memory.data(), &memory[POOL_SIZE - 1] );
+	lua_State* L = CreateScript( pool );
+	LoadScript( L, R"(
+		function Animate()
+			local hero = AnimatedSprite.new()
+			hero:Move( 3, 4 )			-- Sprite's, found in AnimatedSprite's own member table
+			hero:Animate()
+			hero:Animate()
+			hero.x = hero.x * 2			-- and Sprite's properties
+			local rock = Sprite.new()
+			return hero, rock, Global.DistanceSq( hero, rock ), hero.frame
+		end
+		)" );
+	ExecuteScript( L );
+
+	lua_getglobal( L, "Animate" );
+	if ( lua_pcall( L, 0, 4, 0 ) == LUA_OK )
+	{
+		printf( "hero is a Sprite %d, an AnimatedSprite %d, rock is an AnimatedSprite %d\n",
+			ToUserDatum<Sprite>( L, -4 ) != nullptr, ToUserDatum<AnimatedSprite>( L, -4 ) != nullptr, ToUserDatum<AnimatedSprite>( L, -3 ) != nullptr );
+		printf( "distance squared %d, frame %d\n", (int)lua_tointeger( L, -2 ), (int)lua_tointeger( L, -1 ) );
+
+		//AnimatedSprite doesn't say, so it inherits Sprite's DIRTY_TRACKED
+		const std::vector<UserDatum*>& dirty = DirtyObjects( L );
+		bool heroDirty = std::find( dirty.begin(), dirty.end(), ToUserDatum<AnimatedSprite>( L, -4 ) ) != dirty.end();
+		printf( "hero is dirty %d, %d object(s) dirty\n", heroDirty, (int)dirty.size() );
+		assert( heroDirty );
+	}
+	else
+	{
+		printf( "Animate failed '%s'\n", lua_tostring( L, -1 ) );
+	}
+	lua_settop( L, 0 );
+	CloseScript( L );
+}
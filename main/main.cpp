@@ -6,6 +6,8 @@
 #include <new>
 #include <vector>
 #include "AutomatedBinding.h"
+#include "SlotMap.h"
+#include "SpatialHash.h"
 
 int main()
 {
@@ -1068,8 +1070,9 @@ int main()
 		{
 			int x;
 			int y;
+			SlotHandle handle;
 
-			Sprite() : x(0), y(0) {}
+			Sprite() : x(0), y(0), handle{0, 0} {}
 			~Sprite() {}
 
 			void Move(int velX, int velY)
@@ -1084,31 +1087,51 @@ int main()
 			}
 		};
 
+		//each sprite keeps the handle it was given, so forgetting it is O(1) & a handle kept after
+		//the sprite is gone finds nothing, rather than whatever reused the slot
+		//the positions are indexed in a SpatialHash, kept up to date by Move & setting x or y
 		struct SpriteManager
 		{
-			std::vector<Sprite*> m_sprites;
+			SlotMap<Sprite*> m_sprites;
+			SpatialHash m_spriteIndex{32};
+			std::vector<SlotHandle> m_queryResults;	//reused by every query
 			int numberOfSpritesExisting = 0;
 			int numberOfSpritesMade = 0;
 
-			void LookAfterSprite(Sprite* sprite)
+			SlotHandle LookAfterSprite(Sprite* sprite)
 			{
 				numberOfSpritesExisting++;
 				numberOfSpritesMade++;
-				m_sprites.push_back(sprite);
+				SlotHandle handle = m_sprites.Insert(sprite);
+				m_spriteIndex.Insert(handle, sprite->x, sprite->y);
+				return handle;
 			}
 
-			void ForgetSprite(Sprite* sprite)
-			{				
-				int i = 0;
-				for (auto& s : m_sprites)
+			void ForgetSprite(SlotHandle handle)
+			{
+				bool wasLookedAfter = m_sprites.Remove(handle);
+				assert(wasLookedAfter);
+				(void)wasLookedAfter;
+				m_spriteIndex.Remove(handle);
+				numberOfSpritesExisting--;
+			}
+
+			void SpriteMoved(Sprite* sprite)
+			{
+				m_spriteIndex.Move(sprite->handle, sprite->x, sprite->y);
+			}
+
+			Sprite* FindSprite(SlotHandle handle)
+			{
+				Sprite** sprite = m_sprites.Get(handle);
+				return sprite ? *sprite : nullptr;
+			}
+
+			void DrawAll()
+			{
+				for (Sprite* sprite : m_sprites)
 				{
-					if (s == sprite)
-					{
-						numberOfSpritesExisting--;
-						m_sprites.erase(m_sprites.begin() + i);
-						return;
-					}
-					i++;
+					sprite->Draw();
 				}
 			}
 		};
@@ -1129,7 +1152,12 @@ int main()
 			lua_newtable(L);
 			lua_setuservalue(L, 1);
 
-			sm->LookAfterSprite((Sprite*)pointerToASprite);
+			Sprite* sprite = (Sprite*)pointerToASprite;
+			sprite->handle = sm->LookAfterSprite(sprite);
+
+			//so queries can find the userdata from the Sprite*
+			lua_pushvalue(L, -1);
+			lua_rawsetp(L, lua_upvalueindex(2), sprite);
 
 			return 1;
 		};
@@ -1140,20 +1168,74 @@ int main()
 			assert(sm);
 
 			Sprite* sprite = (Sprite*)lua_touserdata(L, -1);
-			sm->ForgetSprite(sprite);
+			sm->ForgetSprite(sprite->handle);
 			sprite->~Sprite();
 			return 0;
 		};
 
 		auto MoveSprite = [](lua_State* L) -> int
 		{
+			SpriteManager* sm = (SpriteManager*)lua_touserdata(L, lua_upvalueindex(1));
+			assert(sm);
+
 			Sprite* sprite = (Sprite*)lua_touserdata(L, -3);
 			lua_Number velX = lua_tonumber(L, -2);
 			lua_Number velY = lua_tonumber(L, -1);
 			sprite->Move((int)velX, (int)velY);
+			sm->SpriteMoved(sprite);
 			return 0;
 		};
 
+		//fills the results table (upvalue 3) with the sprites the query found, returns how many & the table
+		static auto PushQueryResults = [](lua_State* L, SpriteManager* sm) -> int
+		{
+			int resultsIdx = lua_upvalueindex(3);
+			lua_Integer numResults = 0;
+			for (SlotHandle handle : sm->m_queryResults)
+			{
+				Sprite* sprite = sm->FindSprite(handle);
+				if (sprite == nullptr || lua_rawgetp(L, lua_upvalueindex(2), sprite) == LUA_TNIL)
+				{
+					lua_pop(L, sprite ? 1 : 0);		//being collected
+					continue;
+				}
+				lua_rawseti(L, resultsIdx, ++numResults);
+			}
+			//clear what is left from a bigger query before
+			for (lua_Integer i = numResults + 1; lua_rawgeti(L, resultsIdx, i) != LUA_TNIL; i++)
+			{
+				lua_pop(L, 1);
+				lua_pushnil(L);
+				lua_rawseti(L, resultsIdx, i);
+			}
+			lua_pop(L, 1);
+
+			lua_pushinteger(L, numResults);
+			lua_pushvalue(L, resultsIdx);
+			return 2;
+		};
+
+		auto QueryRadius = [](lua_State* L) -> int
+		{
+			SpriteManager* sm = (SpriteManager*)lua_touserdata(L, lua_upvalueindex(1));
+			assert(sm);
+
+			sm->m_queryResults.clear();
+			sm->m_spriteIndex.QueryRadius((int)luaL_checkinteger(L, 1), (int)luaL_checkinteger(L, 2), (int)luaL_checkinteger(L, 3), sm->m_queryResults);
+			return PushQueryResults(L, sm);
+		};
+
+		auto QueryRect = [](lua_State* L) -> int
+		{
+			SpriteManager* sm = (SpriteManager*)lua_touserdata(L, lua_upvalueindex(1));
+			assert(sm);
+
+			sm->m_queryResults.clear();
+			sm->m_spriteIndex.QueryRect((int)luaL_checkinteger(L, 1), (int)luaL_checkinteger(L, 2),
+				(int)luaL_checkinteger(L, 3), (int)luaL_checkinteger(L, 4), sm->m_queryResults);
+			return PushQueryResults(L, sm);
+		};
+
 		auto DrawSprite = [](lua_State* L) -> int
 		{
 			Sprite* sprite = (Sprite*)lua_touserdata(L, -1);
@@ -1204,10 +1286,14 @@ int main()
 			if (strcmp(index, "x") == 0)
 			{
 				sprite->x = (int)lua_tonumber(L, -1);
+				SpriteManager* sm = (SpriteManager*)lua_touserdata(L, lua_upvalueindex(1));
+				sm->SpriteMoved(sprite);
 			}
 			else if (strcmp(index, "y") == 0)
 			{
 				sprite->y = (int)lua_tonumber(L, -1);
+				SpriteManager* sm = (SpriteManager*)lua_touserdata(L, lua_upvalueindex(1));
+				sm->SpriteMoved(sprite);
 			}
 			else
 			{
@@ -1230,6 +1316,12 @@ int main()
 		sprite:Draw()
 		Sprite.new()
 		Sprite.new()
+		local n, near = Sprite.QueryRadius( 0, 0, 5 )	-- the 2 new sprites
+		for i = 1, n do
+			near[i]:Draw()
+		end
+		n, near = Sprite.QueryRect( 90, 0, 100, 20 )	-- sprite
+		near[1]:Draw()
 		)";
 
 		constexpr int POOL_SIZE = 1024 * 10;
@@ -1237,6 +1329,14 @@ int main()
 		ArenaAllocator pool(memory, &memory[POOL_SIZE - 1]);
 		lua_State* L = lua_newstate(ArenaAllocator::l_alloc, &pool);
 
+		//Sprite* -> userdata, weak so it doesn't keep the sprites alive
+		lua_newtable(L);
+		int spriteUserDataIdx = lua_gettop(L);
+		lua_newtable(L);
+		lua_pushstring(L, "v");
+		lua_setfield(L, -2, "__mode");
+		lua_setmetatable(L, spriteUserDataIdx);
+
 		lua_newtable(L);
 		int spriteTableIdx = lua_gettop(L);
 		lua_pushvalue(L, spriteTableIdx);
@@ -1244,10 +1344,27 @@ int main()
 
 		constexpr int NUMBER_OF_UPVALUES = 1;
 		lua_pushlightuserdata(L, &spriteManager);
-		lua_pushcclosure(L, CreateSprite, NUMBER_OF_UPVALUES);
+		lua_pushvalue(L, spriteUserDataIdx);
+		lua_pushcclosure(L, CreateSprite, 2);
 		lua_setfield(L, -2, "new");
-		lua_pushcfunction(L, MoveSprite);
+		lua_pushlightuserdata(L, &spriteManager);
+		lua_pushcclosure(L, MoveSprite, NUMBER_OF_UPVALUES);
 		lua_setfield(L, -2, "Move");
+
+		constexpr int NUMBER_OF_QUERY_UPVALUES = 3;
+		lua_newtable(L);	//the results, shared by both queries
+		int queryResultsIdx = lua_gettop(L);
+		lua_pushlightuserdata(L, &spriteManager);
+		lua_pushvalue(L, spriteUserDataIdx);
+		lua_pushvalue(L, queryResultsIdx);
+		lua_pushcclosure(L, QueryRect, NUMBER_OF_QUERY_UPVALUES);
+		lua_setfield(L, spriteTableIdx, "QueryRect");
+		lua_pushlightuserdata(L, &spriteManager);
+		lua_pushvalue(L, spriteUserDataIdx);
+		lua_pushvalue(L, queryResultsIdx);
+		lua_pushcclosure(L, QueryRadius, NUMBER_OF_QUERY_UPVALUES);
+		lua_setfield(L, spriteTableIdx, "QueryRadius");
+		lua_pop(L, 1);
 		lua_pushcfunction(L, DrawSprite);
 		lua_setfield(L, -2, "Draw");
 
@@ -1262,7 +1379,8 @@ int main()
 		lua_settable(L, -3);
 
 		lua_pushstring(L, "__newindex");
-		lua_pushcfunction(L, SpriteNewIndex);
+		lua_pushlightuserdata(L, &spriteManager);
+		lua_pushcclosure(L, SpriteNewIndex, NUMBER_OF_UPVALUES);
 		lua_settable(L, -3);
 
 		int doResult = luaL_dostring(L, LUA_FILE);
@@ -1271,12 +1389,77 @@ int main()
 			printf("Error: %s\n", lua_tostring(L, -1));
 		}
 
+		spriteManager.DrawAll();
+		SlotHandle firstSprite = spriteManager.m_sprites.Size() > 0 ? (*spriteManager.m_sprites.begin())->handle : SlotHandle{0, 0};
+
 		lua_close(L);
 		
 		assert(spriteManager.numberOfSpritesExisting == 0);
 		assert(spriteManager.numberOfSpritesMade == 3);
+		assert(spriteManager.FindSprite(firstSprite) == nullptr);	//stale handle
+		assert(spriteManager.m_spriteIndex.Count() == 0);
 	}
 
 	extern void AutomatedBindingTutorial();
 	AutomatedBindingTutorial();
+
+	extern void ParallelCompileTutorial();
+	ParallelCompileTutorial();
+
+	extern void StatePoolTutorial();
+	StatePoolTutorial();
+
+	extern void LazyBindingTutorial();
+	LazyBindingTutorial();
+
+	extern void StateImageTutorial();
+	StateImageTutorial();
+
+	extern void ExecutorScalingTutorial();
+	ExecutorScalingTutorial();
+
+	extern void AsyncSchedulerTutorial();
+	AsyncSchedulerTutorial();
+
+	extern void ScriptBudgetTutorial();
+	ScriptBudgetTutorial();
+
+	extern void GcSchedulerTutorial();
+	GcSchedulerTutorial();
+
+	extern void DeferredDestructionTutorial();
+	DeferredDestructionTutorial();
+
+	extern void ProfilerTutorial();
+	ProfilerTutorial();
+
+	extern void BindingStatsTutorial();
+	BindingStatsTutorial();
+
+	extern void TraceTutorial();
+	TraceTutorial();
+
+	extern void PerfCountersTutorial();
+	PerfCountersTutorial();
+
+	extern void NativeBufferTutorial();
+	NativeBufferTutorial();
+
+	extern void DirtyTrackingTutorial();
+	DirtyTrackingTutorial();
+
+	extern void NativeVectorTutorial();
+	NativeVectorTutorial();
+
+	extern void StringMarshallingTutorial();
+	StringMarshallingTutorial();
+
+	extern void ConfigTableTutorial();
+	ConfigTableTutorial();
+
+	extern void ContainerViewTutorial();
+	ContainerViewTutorial();
+
+	extern void InheritanceTutorial();
+	InheritanceTutorial();
 }
\ No newline at end of file